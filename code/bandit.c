@@ -0,0 +1,95 @@
+#ifndef _BANDIT_C
+#define _BANDIT_C
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "bandit.h"
+
+void init_bandit(struct bandit_t *b, int arms, const char **names) {
+	assert(arms > 0 && arms <= BANDIT_MAX_ARMS);
+	memset(b, 0, sizeof(struct bandit_t));
+	b->arms = arms;
+	b->names = names;
+}
+
+/* the probabilities of the arms in 'allowed' (a mask), 0 for the others */
+static void probabilities(struct bandit_t *b, unsigned int allowed, double *p) {
+	double rate[BANDIT_MAX_ARMS], sum = 0, floor;
+	int i, n = 0;
+
+	for ( i = 0 ; i < b->arms ; i++ ) {
+		rate[i] = 0;
+		if ( (allowed & 1 << i) == 0 )
+			continue;
+		n++;
+		if ( b->arm[i].cost > 0 )
+			rate[i] = b->arm[i].gain / b->arm[i].cost;
+		sum += rate[i];
+	}
+
+	floor = n * BANDIT_MIN_PROB < 1 ? BANDIT_MIN_PROB : 1.0 / n;
+	for ( i = 0 ; i < b->arms ; i++ ) {
+		if ( (allowed & 1 << i) == 0 )
+			p[i] = 0;
+		else if ( sum > 0 )
+			p[i] = floor + (1 - n * floor) * rate[i] / sum;
+		else
+			/* nothing paid off yet: all alike */
+			p[i] = 1.0 / n;
+	}
+}
+
+/* an arm among those in 'allowed', a non-empty mask of the arms */
+int bandit_choose(struct bandit_t *b, unsigned int allowed, struct rng_t *rng) {
+	double p[BANDIT_MAX_ARMS], r;
+	int i, last = -1;
+
+	for ( i = 0 ; i < b->arms ; i++ )
+		if ( allowed & 1 << i )
+			last = i;
+	assert(last >= 0);
+
+	probabilities(b, allowed, p);
+	r = draw_real3(rng);
+	for ( i = 0 ; i < last ; i++ ) {
+		r -= p[i];
+		if ( r < 0 )
+			return i;
+	}
+	return last;
+}
+
+/* what using 'arm' bought (gain >= 0) and what it cost */
+void bandit_reward(struct bandit_t *b, int arm, double gain, double cost, int success) {
+	int i;
+
+	for ( i = 0 ; i < b->arms ; i++ ) {
+		b->arm[i].gain *= BANDIT_DECAY;
+		b->arm[i].cost *= BANDIT_DECAY;
+	}
+	b->arm[arm].uses++;
+	b->arm[arm].successes += success != 0;
+	b->arm[arm].gain += gain > 0 ? gain : 0;
+	b->arm[arm].cost += cost;
+	b->arm[arm].total_cost += cost;
+}
+
+/* what the bandit learnt, one line per arm */
+void print_bandit(struct bandit_t *b, char *cost_unit) {
+	double p[BANDIT_MAX_ARMS];
+	int i;
+
+	probabilities(b, (1 << b->arms) - 1, p);
+	printf("%-10s %8s %8s %12s %14s %6s\n", "operator", "uses", "success", 
+			cost_unit, "gain/cost", "prob");
+	for ( i = 0 ; i < b->arms ; i++ )
+		printf("%-10s %8lu %7.1f%% %12.4g %14.6g %6.3f\n", b->names[i], 
+				b->arm[i].uses, b->arm[i].uses > 0 
+				? 100.0 * b->arm[i].successes / b->arm[i].uses : 0, 
+				b->arm[i].total_cost, b->arm[i].cost > 0 
+				? b->arm[i].gain / b->arm[i].cost : 0, p[i]);
+}
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef _BANDIT_H
+#define _BANDIT_H
+
+#include "rng.h"
+
+/*
+ * adaptive choice between the arms of a multi-armed bandit (e.g. the
+ * breeding operators): an arm is chosen with a probability that grows
+ * with the improvement it bought per unit of cost, as measured so far.
+ *
+ * Every arm keeps a floor of BANDIT_MIN_PROB so that none is starved,
+ * and the gains and costs are discounted by BANDIT_DECAY at every
+ * reward, as what pays off changes while the population improves.
+ * Until one pays off, all are alike.
+ */
+#define BANDIT_MAX_ARMS 8
+
+static const double BANDIT_MIN_PROB = 0.05;
+static const double BANDIT_DECAY = 0.99;
+
+struct arm_t {
+	unsigned long uses;
+	unsigned long successes;	/* rewards that counted as a success */
+	double gain;		/* discounted improvement */
+	double cost;		/* discounted cost */
+	double total_cost;	/* over the whole run */
+};
+
+struct bandit_t {
+	int arms;
+	const char **names;
+	struct arm_t arm[BANDIT_MAX_ARMS];
+};
+
+void init_bandit(struct bandit_t *b, int arms, const char **names);
+int bandit_choose(struct bandit_t *b, unsigned int allowed, struct rng_t *rng);
+void bandit_reward(struct bandit_t *b, int arm, double gain, double cost, int success);
+void print_bandit(struct bandit_t *b, char *cost_unit);
+
+#endif
@@ -0,0 +1,198 @@
+#ifndef _BENCH_C
+#define _BENCH_C
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "context.h"
+#include "corpus.h"
+
+/* 
+ * the standard instances: never change one, add a new one instead, or
+ * reports cannot be compared anymore
+ */
+static const struct instance_t INSTANCES[] = {
+	/* name, generations, epochs, desired error, max/starting length, 
+	 * training/testing sessions, budgets, corpus */
+	{ "short", 200, 100, 0.01, 8, 4, 10, 20, { 0, 0 }, 0 },
+	{ "medium", 400, 200, 0.01, 16, 4, 20, 50, { 0, 0 }, 0 },
+	{ "long", 400, 200, 0.01, 32, 8, 20, 50, { 0, 0 }, 0 },
+	{ "many-sessions", 200, 100, 0.01, 16, 4, 100, 200, { 0, 0 }, 0 },
+	{ "budgeted", 400, 200, 0.01, 16, 4, 20, 50, { 20, 100 }, 0 },
+	{ "small-corpus", 400, 200, 0.01, 16, 4, 20, 50, { 0, 0 }, 64 },
+};
+#define NUM_INSTANCES (int)(sizeof(INSTANCES) / sizeof(INSTANCES[0]))
+
+/* the corpus scenarios of the instances are drawn from */
+static const uint64_t BENCH_CORPUS_SEED = 1;
+
+static void fill_run(struct run_t *run, const struct instance_t *in, unsigned int seed) {
+	int i;
+
+	memset(run, 0, sizeof(struct run_t));
+	run->seed = seed;
+	run->generations = in->generations;
+	/* every evaluation and every offspring screened out, with room */
+	run->popsize = 4 * (in->generations + 1);
+	run->max_epochs = in->max_epochs;
+	run->desired_error = in->desired_error;
+	run->max_len = in->max_len;
+	run->starting_len = in->starting_len;
+	run->training_sessions = in->training_sessions;
+	run->testing_sessions = in->testing_sessions;
+	run->datafile = NULL;
+	run->parallel = 1;
+	run->verbose = 0;
+	for ( i = 0 ; i < BENCH_NUM_TARGETS ; i++ )
+		run->targets[i].error = BENCH_TARGETS[i];
+	run->num_targets = BENCH_NUM_TARGETS;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+	double x = *(const double*)a, y = *(const double*)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/* median and mean of n values (sorts them), with a '-' for none */
+static void print_stats(FILE *out, double *values, int n) {
+	double sum = 0;
+	int i;
+
+	if ( n == 0 ) {
+		fprintf(out, " - -");
+		return;
+	}
+	qsort(values, n, sizeof(double), compare_doubles);
+	for ( i = 0 ; i < n ; i++ )
+		sum += values[i];
+	fprintf(out, " %g %g", n % 2 == 1 ? values[n/2] 
+			: (values[n/2-1] + values[n/2]) / 2, sum / n);
+}
+
+/* one line per target of an instance, from its runs */
+static void report_instance(FILE *out, const struct instance_t *in, 
+		struct run_t *runs, int seeds) {
+	double seconds[BENCH_MAX_SEEDS], cpu[BENCH_MAX_SEEDS], evaluations[BENCH_MAX_SEEDS];
+	double ert_seconds, ert_cpu, ert_evaluations;
+	struct target_t *t;
+	int i, j, reached;
+
+	for ( j = 0 ; j < BENCH_NUM_TARGETS ; j++ ) {
+		ert_seconds = ert_cpu = ert_evaluations = 0;
+		for ( i = 0, reached = 0 ; i < seeds ; i++ ) {
+			t = &runs[i].targets[j];
+			if ( t->reached ) {
+				seconds[reached] = t->seconds;
+				cpu[reached] = t->cpu_seconds;
+				evaluations[reached++] = t->evaluations;
+				ert_seconds += t->seconds;
+				ert_cpu += t->cpu_seconds;
+				ert_evaluations += t->evaluations;
+			} else {
+				ert_seconds += runs[i].seconds;
+				ert_cpu += runs[i].cpu_seconds;
+				ert_evaluations += runs[i].evaluations;
+			}
+		}
+
+		fprintf(out, "%s %g %d %d", in->name, BENCH_TARGETS[j], seeds, reached);
+		print_stats(out, seconds, reached);
+		print_stats(out, cpu, reached);
+		print_stats(out, evaluations, reached);
+		if ( reached > 0 )
+			fprintf(out, " %g %g %g\n", ert_seconds / reached, ert_cpu / reached, 
+					ert_evaluations / reached);
+		else
+			fprintf(out, " - - -\n");
+	}
+	fflush(out);
+}
+
+/* the runs of an instance, seeds 1 to 'seeds'; returns -1 on error */
+static int run_instance(const struct instance_t *in, struct run_t *runs, int seeds, 
+		char *corpus_file) {
+	struct corpus_t *given = OPTIONS.corpus;
+	struct budget_t budget = BUDGET;
+	int i;
+
+	if ( in->corpus > 0 ) {
+		if ( write_corpus(corpus_file, in->corpus, BENCH_CORPUS_SEED) < 0 )
+			return -1;
+		OPTIONS.corpus = open_corpus(corpus_file);
+		unlink(corpus_file);
+		if ( OPTIONS.corpus == NULL ) {
+			OPTIONS.corpus = given;
+			return -1;
+		}
+	}
+	BUDGET = in->budget;
+
+	for ( i = 0 ; i < seeds ; i++ ) {
+		fill_run(&runs[i], in, i + 1);
+		/* the runs share the SFMT stream otherwise */
+		init_gen_rand(runs[i].seed);
+		if ( evolve(&runs[i]) < 0 )
+			fprintf(stderr, "%s: run with seed %u did not complete\n", 
+					in->name, runs[i].seed);
+	}
+
+	BUDGET = budget;
+	if ( in->corpus > 0 ) {
+		close_corpus(OPTIONS.corpus);
+		OPTIONS.corpus = given;
+	}
+	return 0;
+}
+
+/* 
+ * every instance over 'seeds' seeds, reported into 'report' as each
+ * one is done; returns -1 on error
+ */
+int run_benchmark(char *report, int seeds) {
+	struct run_t *runs;
+	char corpus_file[strlen(report) + sizeof(".corpus")];
+	FILE *out;
+	int i, j, ret = 0;
+
+	if ( seeds < 1 || seeds > BENCH_MAX_SEEDS ) {
+		fprintf(stderr, "Between 1 and %d seeds\n", BENCH_MAX_SEEDS);
+		return -1;
+	}
+	runs = calloc(seeds, sizeof(struct run_t));
+	if ( runs == NULL ) {
+		perror("Unable to allocate runs");
+		return -1;
+	}
+	out = fopen(report, "w");
+	if ( out == NULL ) {
+		perror("Unable to open the report");
+		free(runs);
+		return -1;
+	}
+	/* next to the report */
+	sprintf(corpus_file, "%s.corpus", report);
+
+	fprintf(out, "# threads %d producers %d deterministic %d seeds %d\n", 
+			OPTIONS.threads, OPTIONS.producers, OPTIONS.deterministic, seeds);
+	fprintf(out, "# instance target runs reached seconds_median seconds_mean "
+			"cpu_median cpu_mean evaluations_median evaluations_mean "
+			"ert_seconds ert_cpu ert_evaluations\n");
+	for ( i = 0 ; i < NUM_INSTANCES ; i++ ) {
+		if ( run_instance(&INSTANCES[i], runs, seeds, corpus_file) < 0 ) {
+			ret = -1;
+			break;
+		}
+		report_instance(out, &INSTANCES[i], runs, seeds);
+		for ( j = 0 ; j < seeds ; j++ )
+			free_run(&runs[j]);
+	}
+
+	fclose(out);
+	free(runs);
+	return ret;
+}
+
+#endif
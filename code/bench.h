@@ -0,0 +1,47 @@
+#ifndef _BENCH_H
+#define _BENCH_H
+
+#include "evolution.h"
+
+/*
+ * time-to-target benchmark: the GA runs on a fixed set of named problem
+ * instances, each over the same seeds, until its best error reaches
+ * every one of BENCH_TARGETS or it runs out of generations. What is
+ * measured is how long it took to get there: wall time, CPU time and
+ * evaluations.
+ *
+ * The report has one line per instance and target, with the share of
+ * runs that reached it, the median and mean of each measure over those
+ * runs, and the expected running time (ERT): the effort of all the runs
+ * (up to the target, or whole when they missed it) over the number that
+ * reached it. Lines starting with '#' are comments.
+ *
+ * Runs go one at a time, with the threads, pipeline and options of the
+ * command line, training in memory: use -d so that the runs, and not
+ * only their timings, are the same from one build to the next.
+ */
+#define BENCH_SEEDS 5		/* default seeds per instance */
+#define BENCH_MAX_SEEDS 100
+
+static const float BENCH_TARGETS[] = { 0.1, 0.05, 0.02, 0.01 };
+#define BENCH_NUM_TARGETS (int)(sizeof(BENCH_TARGETS) / sizeof(BENCH_TARGETS[0]))
+
+/* a problem instance: the parameters of its runs but the seed */
+struct instance_t {
+	char *name;
+	int generations;	/* the most a run goes on */
+	unsigned int max_epochs;
+	float desired_error;
+	int max_len;
+	int starting_len;
+	int training_sessions;
+	int testing_sessions;
+	/* the scenarios: step budgets, and a fixed corpus of that many
+	 * scenarios (0 to draw new ones) */
+	struct budget_t budget;
+	unsigned long corpus;
+};
+
+int run_benchmark(char *report, int seeds);
+
+#endif
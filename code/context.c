@@ -0,0 +1,327 @@
+#ifndef _CONTEXT_C
+#define _CONTEXT_C
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "evolution.h"
+#include "context.h"
+
+/* does nothing: the training set is filled by the simulator */
+static void no_training_data(unsigned int num, unsigned int num_input, unsigned int num_output, 
+		fann_type *input, fann_type *output) {
+}
+
+/* grow a buffer to at least 'need' elements; returns -1 if out of memory */
+int grow_buffer(void **buf, unsigned int *max, unsigned int need, size_t size) {
+	void *p;
+
+	if ( need <= *max )
+		return 0;
+	p = realloc(*buf, need * size);
+	if ( p == NULL )
+		return -1;
+	*buf = p;
+	*max = need;
+	return 0;
+}
+
+struct eval_ctx_t *create_context() {
+	struct eval_ctx_t *ctx;
+
+	ctx = calloc(1, sizeof(struct eval_ctx_t));
+	if ( ctx == NULL )
+		perror("Unable to allocate evaluation context");
+	return ctx;
+}
+
+void destroy_context(struct eval_ctx_t *ctx) {
+	int i;
+
+	if ( ctx == NULL )
+		return;
+
+	if ( ctx->data != NULL ) {
+		/* FANN frees the block through the first row */
+		ctx->data->input[0] = ctx->data_block;
+		fann_destroy_train(ctx->data);
+	}
+	free(ctx->program.ops);
+	free(ctx->testing);
+	free(ctx->testing_inputs);
+	free(ctx->testing_outputs);
+	free(ctx->expected);
+	free(ctx->steps);
+	free(ctx->outcomes);
+	free(ctx->scenarios);
+	free(ctx->conditions);
+	free(ctx->best_weights);
+	for ( i = 0 ; i < (int)ctx->max_replicas ; i++ )
+		if ( ctx->replicas[i] != NULL )
+			fann_destroy(ctx->replicas[i]);
+	free(ctx->replicas);
+	free(ctx->shard_slopes);
+	free(ctx->shards);
+	for ( i = 0 ; i < ctx->num_nets ; i++ )
+		fann_destroy(ctx->nets[i].ann);
+	free(ctx);
+}
+
+/*
+ * make room for an evaluation and lay the buffers out for it;
+ * allocates only beyond the high-water mark
+ */
+int reserve_context(struct eval_ctx_t *ctx, int training, int testing, int inputs, int actions) {
+	unsigned int i, rows, sessions;
+
+	/* the training set: FANN wants a row pointer per session */
+	if ( ctx->data == NULL || (unsigned int)training > ctx->max_rows 
+			|| (unsigned int)(training * inputs) > ctx->max_data ) {
+		unsigned int width = ctx->max_rows > 0 ? ctx->max_data / ctx->max_rows : 0;
+
+		rows = (unsigned int)training > ctx->max_rows ? training : ctx->max_rows;
+		if ( (unsigned int)inputs > width )
+			width = inputs;
+		if ( ctx->data != NULL ) {
+			ctx->data->input[0] = ctx->data_block;
+			fann_destroy_train(ctx->data);
+		}
+		ctx->data = fann_create_train_from_callback(rows, width, NUM_OUTPUT, no_training_data);
+		if ( ctx->data == NULL ) {
+			ctx->max_rows = ctx->max_data = 0;
+			return -1;
+		}
+		ctx->data_block = ctx->data->input[0];
+		ctx->max_rows = rows;
+		ctx->max_data = rows * width;
+	}
+	ctx->data->num_data = training;
+	ctx->data->num_input = inputs;
+	for ( i = 0 ; i < (unsigned int)training ; i++ )
+		ctx->data->input[i] = &ctx->data_block[i * inputs];
+
+	/* the testing sessions */
+	if ( grow_buffer((void**)&ctx->testing, &ctx->max_testing, testing * inputs, sizeof(fann_type)) < 0 )
+		return -1;
+	rows = ctx->max_testing_rows;
+	if ( grow_buffer((void**)&ctx->testing_inputs, &rows, testing, sizeof(fann_type *)) < 0 )
+		return -1;
+	rows = ctx->max_testing_rows;
+	if ( grow_buffer((void**)&ctx->testing_outputs, &rows, testing, sizeof(fann_type)) < 0 )
+		return -1;
+	rows = ctx->max_testing_rows;
+	if ( grow_buffer((void**)&ctx->expected, &rows, testing, sizeof(fann_type)) < 0 )
+		return -1;
+	rows = ctx->max_testing_rows;
+	if ( grow_buffer((void**)&ctx->steps, &rows, testing, sizeof(unsigned int)) < 0 )
+		return -1;
+	rows = ctx->max_testing_rows;
+	if ( grow_buffer((void**)&ctx->outcomes, &rows, testing, sizeof(unsigned int)) < 0 )
+		return -1;
+	ctx->max_testing_rows = rows;
+	for ( i = 0 ; i < (unsigned int)testing ; i++ )
+		ctx->testing_inputs[i] = &ctx->testing[i * inputs];
+
+	/* per session scratch, shared by the training and testing runs */
+	sessions = training > testing ? training : testing;
+	if ( grow_buffer((void**)&ctx->scenarios, &ctx->max_scenarios, sessions, 
+				sizeof(struct scenario_buf_t)) < 0 )
+		return -1;
+	if ( grow_buffer((void**)&ctx->conditions, &ctx->max_conditions, sessions * actions, 
+				sizeof(struct condition_t)) < 0 )
+		return -1;
+
+	return 0;
+}
+
+/* a reused network must train exactly as a new one */
+static void reset_training(struct fann *ann) {
+	unsigned int i;
+
+	if ( ann->train_slopes != NULL )
+		memset(ann->train_slopes, 0, sizeof(fann_type) * ann->total_connections);
+	if ( ann->prev_train_slopes != NULL )
+		memset(ann->prev_train_slopes, 0, sizeof(fann_type) * ann->total_connections);
+	if ( ann->prev_weights_deltas != NULL )
+		memset(ann->prev_weights_deltas, 0, sizeof(fann_type) * ann->total_connections);
+	if ( ann->prev_steps != NULL ) {
+		for ( i = 0 ; i < ann->total_connections ; i++ )
+			ann->prev_steps[i] = ann->training_algorithm == FANN_TRAIN_RPROP 
+				? ann->rprop_delta_zero : 0;
+	}
+	fann_reset_MSE(ann);
+}
+
+/*
+ * a network of the given topology, ready to be trained: the caller
+ * sets the weights. The least recently used network makes room when
+ * the pool is full.
+ */
+struct fann *pooled_network(struct eval_ctx_t *ctx, unsigned int inputs, unsigned int hidden) {
+	struct pooled_net_t *net = NULL;
+	int i;
+
+	for ( i = 0 ; i < ctx->num_nets ; i++ ) {
+		if ( ctx->nets[i].inputs == inputs && ctx->nets[i].hidden == hidden ) {
+			net = &ctx->nets[i];
+			reset_training(net->ann);
+			break;
+		}
+	}
+
+	if ( net == NULL ) {
+		if ( ctx->num_nets < MAX_POOLED_NETS ) {
+			net = &ctx->nets[ctx->num_nets++];
+		} else {
+			net = &ctx->nets[0];
+			for ( i = 1 ; i < ctx->num_nets ; i++ )
+				if ( ctx->nets[i].last_used < net->last_used )
+					net = &ctx->nets[i];
+			fann_destroy(net->ann);
+		}
+		/* params: layers, input neurones, hidden neurones, output neurones */
+		net->ann = fann_create_standard(NUM_LAYERS, inputs, hidden, NUM_OUTPUT);
+		/* never matches if creation failed */
+		net->inputs = net->ann != NULL ? inputs : 0;
+		net->hidden = net->ann != NULL ? hidden : 0;
+	}
+
+	net->last_used = ++ctx->clock;
+
+	return net->ann;
+}
+
+/*
+ * data-parallel training: a copy of the network for every worker (only
+ * its weights are kept up to date), and room for the gradients of every
+ * shard; returns -1 if out of memory
+ */
+int reserve_shards(struct eval_ctx_t *ctx, struct fann *ann, int workers, int shards) {
+	unsigned int i, old = ctx->max_replicas;
+
+	if ( grow_buffer((void**)&ctx->replicas, &ctx->max_replicas, workers, 
+				sizeof(struct fann *)) < 0 )
+		return -1;
+	for ( i = old ; i < ctx->max_replicas ; i++ )
+		ctx->replicas[i] = NULL;
+
+	for ( i = 0 ; i < (unsigned int)workers ; i++ ) {
+		if ( ctx->replicas[i] != NULL && ctx->replicas[i]->num_input == ann->num_input 
+				&& ctx->replicas[i]->total_connections == ann->total_connections 
+				&& ctx->replicas[i]->first_layer[1].first_neuron->activation_function 
+				== ann->first_layer[1].first_neuron->activation_function )
+			continue;
+		if ( ctx->replicas[i] != NULL )
+			fann_destroy(ctx->replicas[i]);
+		ctx->replicas[i] = fann_copy(ann);
+		if ( ctx->replicas[i] == NULL )
+			return -1;
+	}
+
+	if ( grow_buffer((void**)&ctx->shard_slopes, &ctx->max_shard_slopes, 
+				shards * ann->total_connections, sizeof(fann_type)) < 0 
+			|| grow_buffer((void**)&ctx->shards, &ctx->max_shards, shards, 
+				sizeof(struct shard_t)) < 0 )
+		return -1;
+	return 0;
+}
+
+/* keep the weights of a trained network; returns -1 if out of memory */
+int keep_weights(struct warm_t *w, struct fann *ann, char *strategy) {
+	unsigned int len = strlen(strategy) + 1;
+
+	w->num_weights = 0;
+	if ( grow_buffer((void**)&w->strategy, &w->max_strategy, len, 1) < 0 
+			|| grow_buffer((void**)&w->weights, &w->max_weights, 
+				ann->total_connections, sizeof(fann_type)) < 0 )
+		return -1;
+	memcpy(w->strategy, strategy, len);
+	memcpy(w->weights, ann->weights, sizeof(fann_type) * ann->total_connections);
+	w->num_weights = ann->total_connections;
+	w->inputs = ann->first_layer->last_neuron - ann->first_layer->first_neuron - 1;
+	w->hidden = ann->first_layer[1].last_neuron - ann->first_layer[1].first_neuron - 1;
+	return 0;
+}
+
+void free_warm(struct warm_t *w) {
+	free(w->strategy);
+	free(w->weights);
+	memset(w, 0, sizeof(struct warm_t));
+}
+
+/*
+ * which gene of the parent each gene of the child comes from, -1 for
+ * none: the genes before and after the change (one gene changed,
+ * inserted or removed) are the same, shifted around it
+ */
+static void align_genes(char *parent, char *child, int *from) {
+	int np = strlen(parent) / 2, nc = strlen(child) / 2;
+	int prefix, suffix, j;
+
+	for ( prefix = 0 ; prefix < np && prefix < nc 
+			&& memcmp(&parent[2*prefix], &child[2*prefix], 2) == 0 ; prefix++ )
+		;
+	for ( suffix = 0 ; prefix + suffix < np && prefix + suffix < nc 
+			&& memcmp(&parent[2*(np-1-suffix)], &child[2*(nc-1-suffix)], 2) == 0 ; suffix++ )
+		;
+
+	for ( j = 0 ; j < nc ; j++ ) {
+		if ( j < prefix )
+			from[j] = j;
+		else if ( j >= nc - suffix )
+			from[j] = j - nc + np;
+		else
+			from[j] = -1;
+	}
+}
+
+/*
+ * start a network from its parent's trained weights, where they carry
+ * over; the others keep their initial weights.
+ *
+ * Inputs come in slots of 3 (position, angle, status). Only the first
+ * half of the genes run, gene j into slot 2j (see run_strategy()): a
+ * slot takes the weights of the parent's slot filled by the same gene.
+ * Hidden neuron h takes the weights of the parent's hidden neuron h,
+ * for the inputs carried over, and its weight into the output.
+ */
+void warm_start(struct fann *ann, struct warm_t *parent, char *strategy) {
+	int nc = strlen(strategy) / 2, np = strlen(parent->strategy) / 2;
+	unsigned int inputs = 3 * nc, hidden = ann->first_layer[1].last_neuron 
+		- ann->first_layer[1].first_neuron - 1;
+	unsigned int h, i, hidden_kept;
+	int from[nc], input_from[inputs + 1], j, k;
+	struct fann_neuron *neuron;
+	fann_type *pw = parent->weights;
+
+	if ( parent->num_weights == 0 )
+		return;
+	align_genes(parent->strategy, strategy, from);
+
+	/* input i of the child is input input_from[i] of the parent, or none */
+	for ( i = 0 ; i < inputs ; i++ )
+		input_from[i] = -1;
+	for ( j = 0 ; j < (nc + 1) / 2 ; j++ )
+		if ( from[j] >= 0 && from[j] < (np + 1) / 2 )
+			for ( k = 0 ; k < 3 ; k++ )
+				input_from[6*j + k] = 6*from[j] + k;
+	/* and the bias */
+	input_from[inputs] = parent->inputs;
+
+	/* a standard network: hidden neuron h has inputs+1 weights, then the output */
+	hidden_kept = hidden < parent->hidden ? hidden : parent->hidden;
+	for ( h = 0 ; h < hidden_kept ; h++ ) {
+		neuron = &ann->first_layer[1].first_neuron[h];
+		for ( i = 0 ; i <= inputs ; i++ )
+			if ( input_from[i] >= 0 )
+				ann->weights[neuron->first_con + i] = 
+					pw[h * (parent->inputs + 1) + input_from[i]];
+	}
+	neuron = ann->last_layer[-1].first_neuron;
+	for ( h = 0 ; h < hidden_kept ; h++ )
+		ann->weights[neuron->first_con + h] = pw[parent->hidden * (parent->inputs + 1) + h];
+	ann->weights[neuron->first_con + hidden] = 
+		pw[parent->hidden * (parent->inputs + 1) + parent->hidden];
+}
+
+#endif
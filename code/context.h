@@ -0,0 +1,98 @@
+#ifndef _CONTEXT_H
+#define _CONTEXT_H
+
+#include "scenario.h"
+
+/* networks kept per context, one per topology */
+#define MAX_POOLED_NETS 16
+
+struct pooled_net_t {
+	unsigned int inputs, hidden;
+	struct fann *ann;
+	unsigned long last_used;
+};
+
+/* 
+ * the trained weights of a strategy's network, for its offspring to
+ * start from: see warm_start()
+ */
+struct warm_t {
+	char *strategy;		/* what the network was trained for */
+	unsigned int max_strategy;
+	fann_type *weights;
+	unsigned int num_weights, max_weights;
+	unsigned int inputs, hidden;
+};
+
+/* data-parallel training: what a shard of the training set adds up to */
+struct shard_t {
+	float mse;		/* summed squared error */
+	unsigned int num_mse;
+};
+
+/*
+ * everything an evaluation needs, kept from one evaluation to the next:
+ * networks pooled by topology and scratch buffers that only grow, to the
+ * largest strategy and session counts seen so far. Once those are
+ * reached an evaluation does not allocate.
+ *
+ * A context serves one evaluation at a time.
+ */
+struct eval_ctx_t {
+	/* the strategy being evaluated, compiled */
+	char *strategy;
+	struct program_t program;
+	int input_neurones;
+	uint64_t key;		/* key of the evaluation */
+	int keyed;		/* scenarios drawn from keyed streams */
+
+	/* training sessions, in the form FANN trains on */
+	struct fann_train_data *data;
+	fann_type *data_block;	/* the inputs of 'data', max_data elements */
+	unsigned int max_rows, max_data;
+
+	/* testing sessions */
+	fann_type *testing;	/* inputs, one row per session */
+	fann_type **testing_inputs;
+	fann_type *testing_outputs;
+	fann_type *expected;	/* error per session */
+	unsigned int *steps;	/* steps taken per session */
+	unsigned int *outcomes;	/* budgets run out per session */
+	unsigned int max_testing, max_testing_rows;
+
+	/* one scenario and one row of conditions per session */
+	struct scenario_buf_t *scenarios;
+	struct condition_t *conditions;
+	unsigned int max_scenarios, max_conditions;
+
+	struct fann *ann;	/* the network last trained */
+	struct warm_t *warm;	/* to start the next one from, or NULL */
+	struct topology_t *topology;	/* of the next network, NULL for the default */
+	fann_type *best_weights;	/* early stopping: the best weights so far */
+	unsigned int max_best_weights;
+
+	/* data-parallel training: a copy of the network per worker, and
+	 * the gradient of every shard */
+	struct fann **replicas;
+	unsigned int max_replicas;
+	fann_type *shard_slopes;
+	unsigned int max_shard_slopes;
+	struct shard_t *shards;
+	unsigned int max_shards;
+
+	struct pooled_net_t nets[MAX_POOLED_NETS];
+	int num_nets;
+	unsigned long clock;
+};
+
+struct eval_ctx_t *create_context();
+void destroy_context(struct eval_ctx_t *ctx);
+int reserve_context(struct eval_ctx_t *ctx, int training, int testing, int inputs, int actions);
+struct fann *pooled_network(struct eval_ctx_t *ctx, unsigned int inputs, unsigned int hidden);
+int grow_buffer(void **buf, unsigned int *max, unsigned int need, size_t size);
+int reserve_shards(struct eval_ctx_t *ctx, struct fann *ann, int workers, int shards);
+int keep_weights(struct warm_t *w, struct fann *ann, char *strategy);
+void warm_start(struct fann *ann, struct warm_t *parent, char *strategy);
+void free_warm(struct warm_t *w);
+
+#endif
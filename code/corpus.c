@@ -0,0 +1,145 @@
+#ifndef _CORPUS_C
+#define _CORPUS_C
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "corpus.h"
+
+/* records written at a time */
+#define CORPUS_BLOCK 4096
+
+static void corpus_header(struct corpus_header_t *h, uint64_t count, uint64_t seed) {
+	memset(h, 0, sizeof(struct corpus_header_t));
+	memcpy(h->magic, CORPUS_MAGIC, sizeof(CORPUS_MAGIC));
+	h->version = CORPUS_VERSION;
+	h->record_size = sizeof(struct corpus_record_t);
+	h->count = count;
+	h->seed = seed;
+}
+
+/* generate 'count' scenarios into a corpus file; returns -1 on failure */
+int write_corpus(char *filename, uint64_t count, uint64_t seed) {
+	struct corpus_header_t h;
+	struct corpus_record_t *block;
+	struct scenario_buf_t b;
+	struct rng_t rng;
+	uint64_t i, n;
+	FILE *f;
+	int ok = 1;
+
+	block = calloc(CORPUS_BLOCK, sizeof(struct corpus_record_t));
+	f = fopen(filename, "wb");
+	if ( block == NULL || f == NULL ) {
+		perror("Unable to write corpus");
+		free(block);
+		if ( f != NULL )
+			fclose(f);
+		return -1;
+	}
+
+	corpus_header(&h, count, seed);
+	ok = fwrite(&h, sizeof(h), 1, f) == 1;
+	for ( i = 0 ; ok && i < count ; i += n ) {
+		for ( n = 0 ; n < CORPUS_BLOCK && i + n < count ; n++ ) {
+			rng_init(&rng, rng_key(seed, i + n));
+			init_scenario_buf(&b, &rng);
+			block[n].obj1 = b.obj1;
+			block[n].obj2 = b.obj2;
+			block[n].nearest_object_centre = b.scenario.nearest_object_centre;
+		}
+		ok = fwrite(block, sizeof(struct corpus_record_t), n, f) == n;
+	}
+	free(block);
+
+	if ( fclose(f) != 0 || !ok ) {
+		perror("Unable to write corpus");
+		return -1;
+	}
+	return 0;
+}
+
+/* map a corpus, read-only; returns NULL on failure */
+struct corpus_t *open_corpus(char *filename) {
+	struct corpus_header_t expected;
+	const struct corpus_header_t *h;
+	struct corpus_t *c;
+	struct stat st;
+
+	c = calloc(1, sizeof(struct corpus_t));
+	if ( c == NULL ) {
+		perror("Unable to allocate corpus");
+		return NULL;
+	}
+	c->fd = open(filename, O_RDONLY);
+	if ( c->fd < 0 || fstat(c->fd, &st) < 0 ) {
+		perror("Unable to open corpus");
+		goto error;
+	}
+	c->size = st.st_size;
+	if ( c->size < sizeof(struct corpus_header_t) ) {
+		fprintf(stderr, "%s is not a corpus\n", filename);
+		goto error;
+	}
+	c->map = mmap(NULL, c->size, PROT_READ, MAP_SHARED, c->fd, 0);
+	if ( c->map == MAP_FAILED ) {
+		c->map = NULL;
+		perror("Unable to map corpus");
+		goto error;
+	}
+
+	h = c->map;
+	corpus_header(&expected, h->count, h->seed);
+	if ( memcmp(h, &expected, sizeof(expected)) != 0 ) {
+		fprintf(stderr, "%s is not a version %d corpus\n", filename, CORPUS_VERSION);
+		goto error;
+	}
+	if ( h->count == 0 || (c->size - sizeof(struct corpus_header_t)) 
+			/ sizeof(struct corpus_record_t) < h->count ) {
+		fprintf(stderr, "%s is truncated\n", filename);
+		goto error;
+	}
+	c->count = h->count;
+	c->records = (const struct corpus_record_t *)(h + 1);
+
+	/* sessions pick scenarios all over the file */
+	madvise(c->map, c->size, MADV_RANDOM);
+	return c;
+
+error:
+	close_corpus(c);
+	return NULL;
+}
+
+void close_corpus(struct corpus_t *c) {
+	if ( c == NULL )
+		return;
+	if ( c->map != NULL )
+		munmap(c->map, c->size);
+	if ( c->fd >= 0 )
+		close(c->fd);
+	free(c);
+}
+
+/*
+ * the scenario picked by 'draw' (any 64-bit number): its objects are
+ * read in place from the mapping, which is read-only, only the sensor
+ * is the session's own
+ */
+struct scenario_t *corpus_scenario(struct scenario_buf_t *b, struct corpus_t *c, uint64_t draw) {
+	const struct corpus_record_t *r = &c->records[draw % c->count];
+
+	b->scenario.obj1 = (struct object_t *)&r->obj1;
+	b->scenario.obj2 = (struct object_t *)&r->obj2;
+	b->scenario.sensor = &b->sensor;
+	b->scenario.nearest_object_centre = r->nearest_object_centre;
+	reset_sensor(&b->sensor);
+
+	return &b->scenario;
+}
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef _CORPUS_H
+#define _CORPUS_H
+
+#include <stdint.h>
+
+#include "scenario.h"
+
+/*
+ * scenario corpus: scenarios generated once into a file, then mapped
+ * read-only by every process that uses it. The pages are shared
+ * through the page cache; a scenario's objects are used in place.
+ *
+ * The file is a header followed by 'count' records. A file written
+ * with another version or record layout is refused.
+ */
+#define CORPUS_MAGIC "SIMCORP"
+#define CORPUS_VERSION 1
+
+struct corpus_header_t {
+	char magic[8];
+	uint32_t version;
+	uint32_t record_size;
+	uint64_t count;
+	uint64_t seed;		/* record i is drawn from rng_key(seed, i) */
+};
+
+/* one scenario, as gen_scenario() would have drawn it */
+struct corpus_record_t {
+	struct object_t obj1, obj2;
+	float nearest_object_centre;
+	float reserved;		/* keeps records 8-byte aligned */
+};
+
+struct corpus_t {
+	int fd;
+	size_t size;
+	void *map;
+	const struct corpus_record_t *records;
+	uint64_t count;
+};
+
+int write_corpus(char *filename, uint64_t count, uint64_t seed);
+struct corpus_t *open_corpus(char *filename);
+void close_corpus(struct corpus_t *c);
+struct scenario_t *corpus_scenario(struct scenario_buf_t *b, struct corpus_t *c, uint64_t draw);
+
+#endif
@@ -0,0 +1,437 @@
+#ifndef _ENUMERATE_C
+#define _ENUMERATE_C
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "enumerate.h"
+#include "context.h"
+#include "parallel.h"
+#include "lanes.h"
+
+/* strategies taken from a range at a time */
+#define ENUM_CHUNK 16
+/* seconds between checkpoints */
+#define CHECKPOINT_SECONDS 60
+/* strategies printed after the enumeration, the table has them all */
+#define ENUM_PRINTED 10
+
+static const char CHECKPOINT_MAGIC[8] = "SIMENUM5";
+
+/* what a checkpoint is valid for */
+struct checkpoint_header_t {
+	char magic[8];
+	unsigned int genes;
+	unsigned int seed;
+	unsigned int max_epochs;
+	float desired_error;
+	int training_sessions;
+	int testing_sessions;
+	struct budget_t budget;
+	int lanes;		/* trained in lanes, see lanes.h */
+	unsigned long total;
+};
+
+/* the strategies a thread has left, [next, end) */
+struct range_t {
+	pthread_mutex_t lock;
+	unsigned long next, end;
+};
+
+struct enum_t {
+	struct run_t *run;
+	int genes;
+	unsigned long total;
+	unsigned long first[MAX_ENUM_GENES + 2];	/* first strategy of each length */
+
+	/* per strategy */
+	struct fitness_t *fitness;
+	unsigned char *done;	/* set once the fitness is in */
+	unsigned long evaluated;
+
+	struct range_t *ranges;
+	int num_ranges;
+
+	char *checkpoint;
+	pthread_mutex_t checkpoint_lock;
+	time_t last_checkpoint;
+};
+
+/* the genes of strategy 'i': the first gene varies fastest */
+static void decode_strategy(struct enum_t *e, unsigned long i, char *strategy) {
+	int k, j, gene;
+
+	for ( k = 1 ; i >= e->first[k+1] ; k++ )
+		;
+	i -= e->first[k];
+
+	for ( j = 0 ; j < k ; j++ ) {
+		gene = i % GENE_OPTIONS;
+		i /= GENE_OPTIONS;
+		/* all enums start from 1 */
+		strategy[2*j] = gene / NUM_CONDITIONS + 1;
+		strategy[2*j+1] = gene % NUM_CONDITIONS + 1;
+	}
+	strategy[2*k] = '\0';
+}
+
+/*
+ * the next strategies for range 'self': from its own range if it has
+ * any left, otherwise half of the largest other range.
+ * Returns 0 when there is nothing left anywhere.
+ */
+static int take_chunk(struct enum_t *e, int self, unsigned long *first, unsigned long *end) {
+	struct range_t *own = &e->ranges[self], *victim;
+	unsigned long left, most, mid, stolen_end;
+	int r, v;
+
+	while ( 1 ) {
+		pthread_mutex_lock(&own->lock);
+		if ( own->next < own->end ) {
+			*first = own->next;
+			own->next += ENUM_CHUNK;
+			if ( own->next > own->end )
+				own->next = own->end;
+			*end = own->next;
+			pthread_mutex_unlock(&own->lock);
+			return 1;
+		}
+		pthread_mutex_unlock(&own->lock);
+
+		/* steal from the largest range */
+		for ( r = 0, v = -1, most = 0 ; r < e->num_ranges ; r++ ) {
+			if ( r == self )
+				continue;
+			pthread_mutex_lock(&e->ranges[r].lock);
+			left = e->ranges[r].end - e->ranges[r].next;
+			pthread_mutex_unlock(&e->ranges[r].lock);
+			if ( left > most ) {
+				most = left;
+				v = r;
+			}
+		}
+		if ( v < 0 )
+			return 0;
+
+		/* its back half, or its last one; one lock at a time */
+		victim = &e->ranges[v];
+		pthread_mutex_lock(&victim->lock);
+		mid = victim->next + (victim->end - victim->next) / 2;
+		stolen_end = victim->end;
+		if ( mid < stolen_end )
+			victim->end = mid;
+		pthread_mutex_unlock(&victim->lock);
+		if ( mid >= stolen_end )
+			/* emptied in the meantime, look again */
+			continue;
+
+		pthread_mutex_lock(&own->lock);
+		own->next = mid;
+		own->end = stolen_end;
+		pthread_mutex_unlock(&own->lock);
+	}
+}
+
+static int save_checkpoint(struct enum_t *e) {
+	struct checkpoint_header_t h;
+	char tmp[FILENAME_MAX];
+	FILE *f;
+	int ok;
+
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, CHECKPOINT_MAGIC, sizeof(h.magic));
+	h.genes = e->genes;
+	h.seed = e->run->seed;
+	h.max_epochs = e->run->max_epochs;
+	h.desired_error = e->run->desired_error;
+	h.training_sessions = e->run->training_sessions;
+	h.testing_sessions = e->run->testing_sessions;
+	h.budget = BUDGET;
+	h.lanes = OPTIONS.lanes;
+	h.total = e->total;
+
+	/* never leave a half-written checkpoint behind */
+	snprintf(tmp, FILENAME_MAX, "%s.tmp", e->checkpoint);
+	f = fopen(tmp, "wb");
+	if ( f == NULL ) {
+		perror("Unable to open checkpoint");
+		return -1;
+	}
+	/* a fitness may be in without its flag yet: it is just done again */
+	ok = fwrite(&h, sizeof(h), 1, f) == 1
+		&& fwrite(e->done, 1, e->total, f) == e->total
+		&& fwrite(e->fitness, sizeof(struct fitness_t), e->total, f) == e->total;
+	if ( fclose(f) != 0 || !ok || rename(tmp, e->checkpoint) != 0 ) {
+		perror("Unable to save checkpoint");
+		return -1;
+	}
+	return 0;
+}
+
+/* resume from the checkpoint, if there is one; returns -1 if it does not fit */
+static int load_checkpoint(struct enum_t *e) {
+	struct checkpoint_header_t h, expected;
+	unsigned long i;
+	FILE *f;
+	int ok;
+
+	f = fopen(e->checkpoint, "rb");
+	if ( f == NULL )
+		return 0;
+
+	memset(&expected, 0, sizeof(expected));
+	memcpy(expected.magic, CHECKPOINT_MAGIC, sizeof(expected.magic));
+	expected.genes = e->genes;
+	expected.seed = e->run->seed;
+	expected.max_epochs = e->run->max_epochs;
+	expected.desired_error = e->run->desired_error;
+	expected.training_sessions = e->run->training_sessions;
+	expected.testing_sessions = e->run->testing_sessions;
+	expected.budget = BUDGET;
+	expected.lanes = OPTIONS.lanes;
+	expected.total = e->total;
+
+	ok = fread(&h, sizeof(h), 1, f) == 1 && memcmp(&h, &expected, sizeof(h)) == 0;
+	if ( !ok ) {
+		fprintf(stderr, "Checkpoint %s is for other parameters\n", e->checkpoint);
+		fclose(f);
+		return -1;
+	}
+	ok = fread(e->done, 1, e->total, f) == e->total
+		&& fread(e->fitness, sizeof(struct fitness_t), e->total, f) == e->total;
+	fclose(f);
+	if ( !ok ) {
+		fprintf(stderr, "Checkpoint %s is truncated\n", e->checkpoint);
+		return -1;
+	}
+
+	for ( i = 0 ; i < e->total ; i++ )
+		e->evaluated += e->done[i];
+	printf("Resuming: %lu of %lu strategies already evaluated\n", e->evaluated, e->total);
+	return 0;
+}
+
+/* from time to time, by whichever thread gets there first */
+static void maybe_checkpoint(struct enum_t *e) {
+	if ( e->checkpoint == NULL || time(NULL) - e->last_checkpoint < CHECKPOINT_SECONDS )
+		return;
+	if ( pthread_mutex_trylock(&e->checkpoint_lock) != 0 )
+		return;
+	if ( time(NULL) - e->last_checkpoint >= CHECKPOINT_SECONDS ) {
+		save_checkpoint(e);
+		e->last_checkpoint = time(NULL);
+	}
+	pthread_mutex_unlock(&e->checkpoint_lock);
+}
+
+/* eval_lanes() of the strategies waiting for lanes, which are then done */
+static void flush_lanes(struct enum_t *e, struct eval_ctx_t **ctx, struct lanes_t *lanes, 
+		char **strategies, unsigned long *ids, int n) {
+	struct fitness_t fitness[LANES];
+	int k;
+
+	eval_lanes(e->run, ctx, lanes, strategies, ids, n, fitness);
+	for ( k = 0 ; k < n ; k++ )
+		e->fitness[ids[k]] = fitness[k];
+	/* the fitness before the flag, for the checkpoint */
+	__sync_synchronize();
+	for ( k = 0 ; k < n ; k++ )
+		e->done[ids[k]] = 1;
+	__sync_fetch_and_add(&e->evaluated, n);
+}
+
+/*
+ * par_for() body: evaluate the strategies of range 'item', then steal.
+ * With -L they are evaluated LANES at a time, see eval_lanes().
+ */
+static void enumerate_range(void *arg, int item, int worker) {
+	struct enum_t *e = arg;
+	struct eval_ctx_t *ctx[LANES];
+	struct lanes_t lanes;
+	char strategy[LANES][2 * MAX_ENUM_GENES + 1], canonical[2 * MAX_ENUM_GENES + 1];
+	char *waiting[LANES];
+	unsigned long i, first, end, ids[LANES];
+	int k, n = 0, width = OPTIONS.lanes ? LANES : 1;
+
+	memset(&lanes, 0, sizeof(struct lanes_t));
+	for ( k = 0 ; k < width ; k++ ) {
+		ctx[k] = create_context();
+		if ( ctx[k] == NULL ) {
+			while ( k-- > 0 )
+				destroy_context(ctx[k]);
+			return;
+		}
+		waiting[k] = strategy[k];
+	}
+
+	while ( keep_going && take_chunk(e, item, &first, &end) ) {
+		for ( i = first ; i < end && keep_going ; i++ ) {
+			if ( e->done[i] )
+				continue;
+			decode_strategy(e, i, strategy[n]);
+			/* one strategy per behaviour: the others have no length */
+			canonical_strategy(canonical, strategy[n]);
+			if ( strcmp(canonical, strategy[n]) == 0 ) {
+				if ( width > 1 ) {
+					ids[n++] = i;
+					if ( n == width ) {
+						flush_lanes(e, ctx, &lanes, waiting, ids, n);
+						n = 0;
+					}
+					continue;
+				}
+				e->fitness[i] = eval(e->run, ctx[0], strategy[0], i);
+			}
+			/* the fitness before the flag, for the checkpoint */
+			__sync_synchronize();
+			e->done[i] = 1;
+			__sync_fetch_and_add(&e->evaluated, 1);
+		}
+		/* those left over are done again after an interrupt */
+		if ( n > 0 && keep_going ) {
+			flush_lanes(e, ctx, &lanes, waiting, ids, n);
+			n = 0;
+		}
+		maybe_checkpoint(e);
+	}
+
+	for ( k = 0 ; k < width ; k++ )
+		destroy_context(ctx[k]);
+	free_lanes(&lanes);
+}
+
+/* enumeration being ranked, for qsort() */
+static struct enum_t *ranked;
+
+static int by_rank(const void *a, const void *b) {
+	unsigned long i = *(const unsigned long *)a, j = *(const unsigned long *)b;
+	float ri = rank_value(&ranked->fitness[i]), rj = rank_value(&ranked->fitness[j]);
+
+	if ( ri != rj )
+		return ri < rj ? -1 : 1;
+	/* ties in enumeration order */
+	return i < j ? -1 : i > j;
+}
+
+/*
+ * rank what has been evaluated into the table, one strategy per line,
+ * and print the best ones
+ */
+static int save_table(struct enum_t *e, char *filename) {
+	char strategy[2 * MAX_ENUM_GENES + 1];
+	unsigned long *order, n, i, r;
+	struct fitness_t *fit;
+	char *gene;
+	FILE *f;
+
+	order = malloc(sizeof(unsigned long) * (e->evaluated + 1));
+	if ( order == NULL ) {
+		perror("Unable to allocate ranking");
+		return -1;
+	}
+	/* failed evaluations and non canonical strategies (no length) are not ranked */
+	for ( i = 0, n = 0 ; i < e->total ; i++ )
+		if ( e->done[i] && e->fitness[i].length > 0 && !e->fitness[i].failed )
+			order[n++] = i;
+	ranked = e;
+	qsort(order, n, sizeof(unsigned long), by_rank);
+
+	f = fopen(filename, "w");
+	if ( f == NULL ) {
+		perror("Unable to open table");
+		free(order);
+		return -1;
+	}
+	fprintf(f, "# rank strategy error steps length over_budget "
+			"(%lu distinct behaviours of %lu strategies, seed %u)\n", n, e->total, e->run->seed);
+	for ( r = 0 ; r < n ; r++ ) {
+		fit = &e->fitness[order[r]];
+		decode_strategy(e, order[r], strategy);
+		fprintf(f, "%lu ", r + 1);
+		for ( gene = strategy ; *gene != '\0' ; gene++ )
+			fprintf(f, "%d", *gene);
+		fprintf(f, " %f %.1f %d %.2f\n", fit->error, fit->steps, fit->length,
+				fit->over_budget);
+
+		if ( r < ENUM_PRINTED ) {
+			printf("%lu (fitness %f, steps %.1f, length %d, over budget %.0f%%): ", r + 1,
+					fit->error, fit->steps, fit->length, 100 * fit->over_budget);
+			for ( gene = strategy ; *gene != '\0' ; gene++ )
+				printf("%d", *gene);
+			printf("\n");
+		}
+	}
+	free(order);
+
+	if ( fclose(f) != 0 ) {
+		perror("Unable to close table");
+		return -1;
+	}
+	return 0;
+}
+
+int enumerate(struct run_t *run, int genes, char *table, char *checkpoint) {
+	struct enum_t e;
+	unsigned long size;
+	int i, ret = -1;
+
+	if ( genes < 1 || genes > MAX_ENUM_GENES ) {
+		fprintf(stderr, "Enumeration goes from 1 to %d genes\n", MAX_ENUM_GENES);
+		return -1;
+	}
+
+	memset(&e, 0, sizeof(e));
+	e.run = run;
+	e.genes = genes;
+	e.checkpoint = checkpoint;
+	pthread_mutex_init(&e.checkpoint_lock, NULL);
+	e.last_checkpoint = time(NULL);
+
+	/* 12 + 12^2 + ... + 12^genes */
+	e.first[1] = 0;
+	for ( i = 1, size = GENE_OPTIONS ; i <= genes ; i++, size *= GENE_OPTIONS )
+		e.first[i+1] = e.first[i] + size;
+	e.total = e.first[genes+1];
+
+	e.fitness = calloc(e.total, sizeof(struct fitness_t));
+	e.done = calloc(e.total, 1);
+	e.num_ranges = par_workers();
+	e.ranges = calloc(e.num_ranges, sizeof(struct range_t));
+	if ( e.fitness == NULL || e.done == NULL || e.ranges == NULL ) {
+		perror("Unable to allocate enumeration");
+		goto out;
+	}
+	if ( checkpoint != NULL && load_checkpoint(&e) < 0 )
+		goto out;
+
+	/* contiguous ranges: the longer strategies, at the end, cost more */
+	for ( i = 0 ; i < e.num_ranges ; i++ ) {
+		pthread_mutex_init(&e.ranges[i].lock, NULL);
+		e.ranges[i].next = e.total * i / e.num_ranges;
+		e.ranges[i].end = e.total * (i + 1) / e.num_ranges;
+	}
+
+	keep_going = 1;
+	par_for(e.num_ranges, enumerate_range, &e);
+
+	if ( checkpoint != NULL )
+		save_checkpoint(&e);
+	if ( keep_going == 0 )
+		printf("Interrupted: %lu of %lu strategies evaluated\n", e.evaluated, e.total);
+	else
+		printf("%lu strategies enumerated\n", e.total);
+	ret = save_table(&e, table);
+
+out:
+	for ( i = 0 ; e.ranges != NULL && i < e.num_ranges ; i++ )
+		pthread_mutex_destroy(&e.ranges[i].lock);
+	pthread_mutex_destroy(&e.checkpoint_lock);
+	free(e.ranges);
+	free(e.fitness);
+	free(e.done);
+	return ret;
+}
+
+#endif
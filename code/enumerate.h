@@ -0,0 +1,30 @@
+#ifndef _ENUMERATE_H
+#define _ENUMERATE_H
+
+#include "evolution.h"
+
+/* 6 actions x 2 conditions */
+#define GENE_OPTIONS 12
+/* 12^6 strategies of 6 genes, ~3M in all */
+#define MAX_ENUM_GENES 6
+
+/*
+ * exhaustive enumeration: every strategy of 1 to 'genes' genes is
+ * evaluated, in deterministic mode, with the run's seed, epochs and
+ * sessions. Strategy i (in order of length, then of genes) is
+ * evaluation i, so the results do not depend on the threads.
+ *
+ * The strategies are split into one range per thread of the worker
+ * pool; a thread that runs out steals half of the largest range left.
+ * With -L a thread evaluates LANES strategies at a time, their networks
+ * trained together (see lanes.h).
+ *
+ * Only canonical strategies (see canonical_strategy()) are evaluated,
+ * one per behaviour, and ranked by rank_value() into 'table'.
+ * If 'checkpoint' is not NULL the progress is saved there from time to
+ * time and on interrupt, and a later call with the same file and
+ * parameters resumes from it.
+ */
+int enumerate(struct run_t *run, int genes, char *table, char *checkpoint);
+
+#endif
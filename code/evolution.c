@@ -1,50 +1,333 @@
 #ifndef _EVOLUTION_C
 #define _EVOLUTION_C
 
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+#include "fann_internal.h"
+
 #include "evolution.h"
+#include "context.h"
+#include "parallel.h"
+#include "pipeline.h"
+#include "queue.h"
+#include "surrogate.h"
+#include "bandit.h"
+#include "trace.h"
+#include "lanes.h"
 
 /**********************/
-extern inline void dbg(char*);
 
-unsigned int MAX_EPOCHS;
-float DESIRED_ERROR;
-unsigned int STRATEGY_MAX_LENGTH;
-int TRAINING_SESSIONS;
-int TESTING_SESSIONS;
+volatile sig_atomic_t keep_going;
 
-/**
- * evaluate strategy on random scenarios through an artificial NN 
+/* single thread, original behaviour */
+struct options_t OPTIONS = { 1, 0, 1, OBJ_ERROR, 0, 0, NULL, NULL, 0, 0, 10, 3, 0, 0, 0, 0, 0, 0, 0 };
+
+/* 
+ * of the run going on in this thread: the strategy operators run on
+ * the thread of their run, the other parameters go with the run
  */
-static float eval(char* strategy, char* datafile) {
-	float fitness = -1.0;
-	/* initialised at NULL to start */
-	struct scenario_t *train_scenario = NULL, *run_scenario = NULL;
-	struct fann *ann;	/* the artificial neural network */
-	int i, j;
+__thread unsigned int STRATEGY_MAX_LENGTH;
+
+/* one batch of simulated sessions for an evaluation */
+struct sessions_t {
+	struct program_t *program;	/* the compiled strategy */
+	int input_neurones;
+	struct scenario_buf_t *scenarios;	/* one per session */
+	int drawn;			/* scenarios already drawn from SFMT */
+	struct condition_t *conditions;	/* one row of program->num_actions per session */
+	uint64_t key;			/* keyed mode: key of the batch */
+	fann_type **inputs;		/* one row of input_neurones per session */
+	fann_type *outputs;		/* the expected output per session */
+	unsigned int *steps;		/* steps taken per session, or NULL */
+	unsigned int *outcomes;		/* budgets run out per session, or NULL */
+	int failed;
+};
 
-	FILE *f;
+/*
+ * par_for() body: run the strategy on scenario 'item' of the batch
+ */
+static void simulate_session(void *arg, int item, int worker) {
+	struct sessions_t *job = arg;
+	struct scenario_t *scenario;
+	struct rng_t rng;
+
+	if ( job->drawn ) {
+		scenario = &job->scenarios[item].scenario;
+	} else if ( OPTIONS.corpus != NULL ) {
+		scenario = corpus_scenario(&job->scenarios[item], OPTIONS.corpus, 
+				rng_key(job->key, item));
+	} else {
+		rng_init(&rng, rng_key(job->key, item));
+		scenario = init_scenario_buf(&job->scenarios[item], &rng);
+	}
+
+	if ( run_program_mem(job->program, scenario, job->inputs[item], job->input_neurones, 
+				&job->conditions[item * job->program->num_actions]) < 0 )
+		job->failed = 1;
+	job->outputs[item] = scenario->nearest_object_centre;
+	if ( job->steps != NULL ) {
+		job->steps[item] = scenario->sensor->lateral_steps + scenario->sensor->angular_steps;
+		job->outcomes[item] = scenario->sensor->outcome;
+	}
+}
+
+/*
+ * simulate 'sessions' runs of the strategy, in parallel if asked.
+ * In keyed mode each scenario is drawn from its own stream; otherwise
+ * the scenarios are drawn here, in order, from the SFMT sequence, so
+ * that the sequence of random numbers is the same as a sequential run.
+ */
+static int simulate_sessions(struct sessions_t *job, int sessions, int keyed, int parallel) {
+	int i;
+
+	job->failed = 0;
+	job->drawn = 0;
+	if ( keyed == 0 ) {
+		for ( i = 0 ; i < sessions ; i++ ) {
+			if ( OPTIONS.corpus != NULL )
+				corpus_scenario(&job->scenarios[i], OPTIONS.corpus, 
+						((uint64_t)gen_rand32() << 32) | gen_rand32());
+			else
+				init_scenario_buf(&job->scenarios[i], NULL);
+		}
+		job->drawn = 1;
+	}
+
+	if ( parallel ) {
+		par_for(sessions, simulate_session, job);
+	} else {
+		for ( i = 0 ; i < sessions ; i++ )
+			simulate_session(job, i, 0);
+	}
+
+	return job->failed ? -1 : 0;
+}
+
+/*
+ * run the strategy on all the training and testing scenarios of an
+ * evaluation, into the context: the cheap stage, before the network is
+ * trained and tested
+ */
+static int simulate(struct run_t *run, struct eval_ctx_t *ctx, char *strategy, 
+		uint64_t key, int keyed, int parallel) {
+	struct sessions_t job;
 
 	/* 
 	 * the number of input neurons is the number of actions
 	 * in a strategy
 	 */
-	int input_neurones = get_input_neurones(strategy);
+	ctx->strategy = strategy;
+	ctx->input_neurones = get_input_neurones(strategy);
+	ctx->key = key;
+	ctx->keyed = keyed;
 
-	/* where to store the data to be fed to the network as input */
-	fann_type results[input_neurones];	
-	fann_type *network_output;	/* the network output */
-	fann_type expected_results[TESTING_SESSIONS];	/* the expected output */
+	/*
+	 * decoded once for all the sessions, here rather than at birth:
+	 * a strategy is evaluated once (the population remembers its
+	 * fitness), the loser is bred over in place, and decoding is linear
+	 * in the genes into the context's buffer, against the thousands of
+	 * sessions run on it
+	 */
+	if ( compile_strategy_into(&ctx->program, strategy) < 0 
+			|| reserve_context(ctx, run->training_sessions, run->testing_sessions, 
+				ctx->input_neurones, ctx->program.num_actions) < 0 ) {
+		perror("Unable to allocate sessions");
+		return -1;
+	}
+
+	/* generate the training scenarios and run the strategy on them */
+	job.program = &ctx->program;
+	job.input_neurones = ctx->input_neurones;
+	job.scenarios = ctx->scenarios;
+	job.conditions = ctx->conditions;
+	job.key = rng_key(key, KEY_TRAINING);
+	job.inputs = ctx->data->input;
+	/* a single output: rows are contiguous */
+	job.outputs = ctx->data->output[0];
+	job.steps = NULL;
+	if ( simulate_sessions(&job, run->training_sessions, keyed, parallel) < 0 ) {
+		/* problem here */
+		fprintf(stderr, "Error in running strategy for training\n");
+		return -1;
+	}
+
+	/* the same for the testing scenarios */
+	job.key = rng_key(key, KEY_TESTING);
+	job.inputs = ctx->testing_inputs;
+	job.outputs = ctx->testing_outputs;
+	job.steps = ctx->steps;
+	job.outcomes = ctx->outcomes;
+	if ( simulate_sessions(&job, run->testing_sessions, keyed, parallel) < 0 ) {
+		fprintf(stderr, "Error in running strategy for testing\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+/* one epoch of data-parallel training */
+struct shards_t {
+	struct eval_ctx_t *ctx;
+	struct fann *ann;
+	struct fann_train_data *data;
+};
+
+/*
+ * par_for() body: the gradient of shard 'item' of the training set, on
+ * the worker's copy of the network
+ */
+static void train_shard(void *arg, int item, int worker) {
+	struct shards_t *job = arg;
+	struct fann *replica = job->ctx->replicas[worker];
+	unsigned int i, first = item * TRAINING_SHARD, last = first + TRAINING_SHARD;
+	size_t size = sizeof(fann_type) * replica->total_connections;
+
+	if ( last > job->data->num_data )
+		last = job->data->num_data;
+
+	memcpy(replica->weights, job->ann->weights, size);
+	fann_reset_MSE(replica);
+	if ( replica->train_slopes != NULL )
+		memset(replica->train_slopes, 0, size);
+	for ( i = first ; i < last ; i++ ) {
+		fann_run(replica, job->data->input[i]);
+		fann_compute_MSE(replica, job->data->output[i]);
+		fann_backpropagate_MSE(replica);
+		fann_update_slopes_batch(replica, replica->first_layer + 1, replica->last_layer - 1);
+	}
 
-	/* create neural network 
-	 * params: layers, input neurones, hidden neurones, output neurones */
-	ann = fann_create_standard(NUM_LAYERS, (unsigned int)input_neurones, 
-			(unsigned int)input_neurones+5, NUM_OUTPUT); 
+	memcpy(&job->ctx->shard_slopes[item * replica->total_connections], 
+			replica->train_slopes, size);
+	job->ctx->shards[item].mse = replica->MSE_value;
+	job->ctx->shards[item].num_mse = replica->num_MSE;
+}
+
+/*
+ * one epoch of training, as fann_train_epoch() with RPROP. With
+ * OPTIONS.sharded_training the training set is cut into shards of
+ * TRAINING_SHARD sessions, their gradients computed on all the threads
+ * then summed in shard order: the result does not depend on the number
+ * of threads (but is not bit for bit that of fann_train_epoch()).
+ */
+static float train_epoch(struct eval_ctx_t *ctx, struct fann *ann, 
+		struct fann_train_data *data) {
+	int workers = par_workers() > 0 ? par_workers() : 1;
+	int shards = (data->num_data + TRAINING_SHARD - 1) / TRAINING_SHARD, s;
+	unsigned int c, total = ann->total_connections;
+	struct shards_t job;
+	fann_type *slopes;
+
+	if ( OPTIONS.sharded_training == 0 || shards < 2 
+			|| reserve_shards(ctx, ann, workers, shards) < 0 )
+		return fann_train_epoch(ann, data);
+
+	job.ctx = ctx;
+	job.ann = ann;
+	job.data = data;
+	par_for(shards, train_shard, &job);
+
+	/* the reduction, always in the same order */
+	if ( ann->prev_train_slopes == NULL )
+		fann_clear_train_arrays(ann);
+	memcpy(ann->train_slopes, ctx->shard_slopes, sizeof(fann_type) * total);
+	ann->MSE_value = ctx->shards[0].mse;
+	ann->num_MSE = ctx->shards[0].num_mse;
+	for ( s = 1 ; s < shards ; s++ ) {
+		slopes = &ctx->shard_slopes[s * total];
+		for ( c = 0 ; c < total ; c++ )
+			ann->train_slopes[c] += slopes[c];
+		ann->MSE_value += ctx->shards[s].mse;
+		ann->num_MSE += ctx->shards[s].num_mse;
+	}
+
+	fann_update_weights_irpropm(ann, 0, total);
+	return fann_get_MSE(ann);
+}
+
+/*
+ * the fixed schedule of fann_train_on_data(): train until the error is
+ * down to desired_error, for at most max_epochs. Returns the epochs.
+ */
+static unsigned int train_epochs(struct run_t *run, struct eval_ctx_t *ctx, 
+		struct fann *ann, struct fann_train_data *data) {
+	unsigned int epoch;
+
+	for ( epoch = 1 ; epoch <= run->max_epochs ; epoch++ )
+		if ( train_epoch(ctx, ann, data) <= run->desired_error )
+			return epoch;
+	return run->max_epochs;
+}
+
+/*
+ * the adaptive schedule: the last sessions of the training set are held
+ * out, and checked every OPTIONS.check_every epochs. Training stops when
+ * the validation error has not improved for OPTIONS.patience checks, or
+ * diverges, and the network goes back to its best weights. Returns the
+ * epochs.
+ */
+static unsigned int train_validated(struct run_t *run, struct eval_ctx_t *ctx, 
+		struct fann *ann) {
+	struct fann_train_data training = *ctx->data, validation = *ctx->data;
+	unsigned int held = (unsigned int)(ctx->data->num_data * OPTIONS.validation);
+	unsigned int epoch, stale = 0;
+	size_t size = sizeof(fann_type) * ann->total_connections;
+	float error, best;
+
+	if ( held == 0 || held >= ctx->data->num_data || OPTIONS.check_every == 0
+			|| grow_buffer((void**)&ctx->best_weights, &ctx->max_best_weights, 
+				ann->total_connections, sizeof(fann_type)) < 0 )
+		return train_epochs(run, ctx, ann, ctx->data);
+
+	training.num_data -= held;
+	validation.input += training.num_data;
+	validation.output += training.num_data;
+	validation.num_data = held;
+
+	best = fann_test_data(ann, &validation);
+	memcpy(ctx->best_weights, ann->weights, size);
+	for ( epoch = 1 ; epoch <= run->max_epochs ; epoch++ ) {
+		if ( train_epoch(ctx, ann, &training) <= run->desired_error )
+			break;
+		if ( epoch % OPTIONS.check_every != 0 )
+			continue;
+
+		error = fann_test_data(ann, &validation);
+		if ( error < best * (1 - PLATEAU_TOLERANCE) ) {
+			best = error;
+			memcpy(ctx->best_weights, ann->weights, size);
+			stale = 0;
+		} else if ( error > best * DIVERGENCE_RATIO || ++stale >= OPTIONS.patience ) {
+			memcpy(ann->weights, ctx->best_weights, size);
+			break;
+		}
+	}
+
+	return epoch > run->max_epochs ? run->max_epochs : epoch;
+}
+
+/*
+ * train the network on the simulated sessions, returns the epochs or
+ * -1; without a data file the training set stays in memory
+ */
+static int train(struct run_t *run, struct eval_ctx_t *ctx, struct fann *ann, 
+		char* datafile) {
+	struct fann_train_data *data = ctx->data;
+	unsigned int i, j, epochs;
+	FILE *f;
+
+	if ( OPTIONS.validation > 0 )
+		return train_validated(run, ctx, ann);
+	if ( datafile == NULL )
+		return train_epochs(run, ctx, ann, data);
+
+	/* original behaviour: go through the data file */
 
 	/* prepare the file for writing */
 	f = fopen(datafile, "w+");
 	if ( f == NULL ) {
 		perror("Unable to open file for writing");
-		fann_destroy(ann); 
 		return -1;
 	}
 
@@ -56,46 +339,84 @@ static float eval(char* strategy, char* datafile) {
 	 * third line:
 	 * expected output 
 	 */
-	fprintf(f, "%d %d %d\n", TRAINING_SESSIONS, get_input_neurones(strategy), NUM_OUTPUT);
-
-
-	for ( i = 0 ; i < TRAINING_SESSIONS ; i++ ) {
-		/* generate a new training scenario */
-		train_scenario = gen_scenario();
-
-		/* run strategy */
-		if ( run_strategy_mem(strategy, train_scenario, results, input_neurones) < 0 ) {
-			/* problem here */
-			fprintf(stderr, "Error in running strategy for training\n");
-			fclose(f);
-			destroy_scenario(train_scenario);
-			fann_destroy(ann); 
-			return -1;
-		}
+	fprintf(f, "%d %d %d\n", data->num_data, data->num_input, NUM_OUTPUT);
 
+	for ( i = 0 ; i < data->num_data ; i++ ) {
 		/* print collected values in the way the neural network expects
 		 * to find them */
-		for ( j = 0 ; j < input_neurones ; j++ ) {
-			fprintf(f, "%f ", results[j]);
+		for ( j = 0 ; j < data->num_input ; j++ ) {
+			fprintf(f, "%f ", data->input[i][j]);
 		}
 		/* next line is output */
-		fprintf(f, "\n%f\n", train_scenario->nearest_object_centre);
+		fprintf(f, "\n%f\n", data->output[i][0]);
 	}
 
 	if ( fclose(f) != 0 ) {
 		perror("Unable to close file");
-		destroy_scenario(train_scenario);
-		fann_destroy(ann); 
 		return -1;
 	}
 
-	/* train NN on results */
-	fann_train_on_file(ann, datafile, 
-			MAX_EPOCHS, EPOCHS_BETWEEN_REPORTS, DESIRED_ERROR);
+	/* train NN on results, read back as fann_train_on_file() does */
+	data = fann_read_train_from_file(datafile);
+	if ( data == NULL ) {
+		fprintf(stderr, "Unable to read training data\n");
+		return -1;
+	}
+	epochs = train_epochs(run, ctx, ann, data);
+	fann_destroy_train(data);
+
+	return epochs;
+}
+
+/* FANN's activation for each activation_e */
+static const enum fann_activationfunc_enum ACTIVATIONS[NUM_ACTIVATIONS] = 
+	{ FANN_SIGMOID_STEPWISE, FANN_ELLIOT };
+static const char *ACTIVATION_NAMES[NUM_ACTIVATIONS] = { "sigmoid-stepwise", "elliot" };
+
+/*
+ * the network of the evaluation in 'ctx', pooled, with new initial
+ * weights; NULL if out of memory
+ */
+static struct fann *initial_network(struct eval_ctx_t *ctx) {
+	struct fann *ann;
+
+	ann = pooled_network(ctx, (unsigned int)ctx->input_neurones, ctx->topology != NULL 
+			? ctx->topology->hidden : (unsigned int)ctx->input_neurones+5);
+	if ( ann == NULL ) {
+		fprintf(stderr, "Unable to create network\n");
+		return NULL;
+	}
+	/* pooled networks are shared by all the activations */
+	if ( ctx->topology != NULL )
+		fann_set_activation_function_hidden(ann, ACTIVATIONS[ctx->topology->activation]);
+	if ( OPTIONS.deterministic ) {
+		/* FANN seeds its own initial weights from the clock */
+		struct rng_t rng;
+		unsigned int c;
+		rng_init(&rng, rng_key(ctx->key, KEY_WEIGHTS));
+		for ( c = 0 ; c < ann->total_connections ; c++ )
+			ann->weights[c] = (fann_type)(rng_real3(&rng) * 0.2 - 0.1);
+	} else {
+		/* the same range as fann_create_standard() */
+		fann_randomize_weights(ann, -0.1, 0.1);
+	}
+	/* carry over what the parent learnt */
+	if ( ctx->warm != NULL )
+		warm_start(ann, ctx->warm, ctx->strategy);
+	ctx->ann = ann;
+
+	return ann;
+}
 
-	/* done with the training scenario
-	 * (could avoid destroying this, but it is for clarity */
-	destroy_scenario(train_scenario);
+/* test the trained network on the testing sessions: the fitness */
+static struct fitness_t test_network(struct run_t *run, struct eval_ctx_t *ctx, 
+		struct fann *ann, unsigned int epochs) {
+	/* the error starts from -1, as it always has */
+	struct fitness_t fitness = { -1.0, 0, 0, 0 };
+	float steps = 0;
+	int over_budget = 0;
+	fann_type *network_output;	/* the network output */
+	int i;
 
 	/*
 	 * run the same network through 100 different scenarios
@@ -103,40 +424,331 @@ static float eval(char* strategy, char* datafile) {
 	 * measure goodness of the answers, do average/sqr err
 	 * that's the fitness
 	 */
-	for ( i = 0 ; i < TESTING_SESSIONS ; i++ ) {
+	for ( i = 0 ; i < run->testing_sessions ; i++ ) {
+		/* run the neural network on the new input */
+		network_output = fann_run(ann, ctx->testing_inputs[i]); 
+
+		/* compare the network output with the expected value */
+		ctx->expected[i] = fabs(ctx->testing_outputs[i] - *network_output);
+	}
 
-		/* generate a new scenario */
-		run_scenario = gen_scenario();
+	/* summed in session order, whatever thread ran the session */
+	for ( i = 0 ; i < run->testing_sessions ; i++ ) {
+		fitness.error += (float)ctx->expected[i];
+		steps += ctx->steps[i];
+		if ( ctx->outcomes[i] != 0 )
+			over_budget++;
+		/* counts only: the order does not matter */
+		__sync_fetch_and_add(&run->histogram[ctx->steps[i] < HISTOGRAM_BINS 
+				? ctx->steps[i] : HISTOGRAM_BINS - 1], 1);
+	}
+	fitness.error /= run->testing_sessions;
+
+	/* the cost of the answer on the device */
+	fitness.steps = steps / run->testing_sessions;
+	fitness.length = ctx->program.num_actions;
+	fitness.over_budget = (float)over_budget / run->testing_sessions;
+	fitness.epochs = epochs;
+	fitness.connections = ann->total_connections;
+
+	return fitness;
+}
+
+/*
+ * train a network on the simulated sessions and test it: the expensive
+ * stage. Returns the fitness.
+ */
+static struct fitness_t score(struct run_t *run, struct eval_ctx_t *ctx, char *datafile) {
+	struct fitness_t failed = { -1.0, 0, 0, 0, 0, 0, 1 };
+	struct fann *ann;	/* the artificial neural network */
+	int epochs;
+
+	ann = initial_network(ctx);
+	if ( ann == NULL )
+		return failed;
+
+	/* train NN on results */
+	epochs = train(run, ctx, ann, datafile);
+	if ( epochs < 0 )
+		return failed;
+	__sync_fetch_and_add(&run->epochs, epochs);
+
+	return test_network(run, ctx, ann, epochs);
+}
+
+/*
+ * score() of up to LANES simulated candidates, their networks trained
+ * together (see lanes.h). With early stopping (-V) or sharded training
+ * (-T) they are trained one by one by score(), as they are when their
+ * networks cannot share the lanes.
+ */
+static void score_lanes(struct run_t *run, struct lanes_t *lanes, struct eval_ctx_t **ctxs, 
+		int n, struct fitness_t *fitness) {
+	struct fitness_t failed = { -1.0, 0, 0, 0, 0, 0, 1 };
+	struct fann *anns[LANES];
+	struct fann_train_data *data[LANES];
+	unsigned int epochs[LANES];
+	int i, lane[LANES], used = 0;
+
+	if ( OPTIONS.validation == 0 && OPTIONS.sharded_training == 0 ) {
+		for ( i = 0 ; i < n ; i++ ) {
+			fitness[i] = failed;
+			if ( ctxs[i]->strategy == NULL || (anns[used] = initial_network(ctxs[i])) == NULL )
+				continue;
+			data[used] = ctxs[i]->data;
+			lane[used++] = i;
+		}
+		if ( used == 0 || train_lanes(lanes, anns, data, used, run->max_epochs, 
+					run->desired_error, epochs) == 0 ) {
+			for ( i = 0 ; i < used ; i++ ) {
+				__sync_fetch_and_add(&run->epochs, epochs[i]);
+				fitness[lane[i]] = test_network(run, ctxs[lane[i]], anns[i], epochs[i]);
+			}
+			return;
+		}
+	}
+
+	for ( i = 0 ; i < n ; i++ )
+		fitness[i] = ctxs[i]->strategy != NULL ? score(run, ctxs[i], NULL) : failed;
+}
+
+/**
+ * evaluate strategy on random scenarios through an artificial NN 
+ *
+ * 'eval_id' identifies the evaluation: in deterministic mode every
+ * random draw (scenarios, initial weights) is keyed to it.
+ * 'ctx' is reused from one evaluation to the next.
+ * The run gives the sessions, epochs and desired error.
+ */
+struct fitness_t eval(struct run_t *run, struct eval_ctx_t *ctx, char* strategy, 
+		unsigned long eval_id) {
+	struct fitness_t failed = { -1.0, 0, 0, 0, 0, 0, 1 };
+
+	ctx->ann = NULL;
+	if ( simulate(run, ctx, strategy, rng_key(run->seed, eval_id), 
+				OPTIONS.deterministic, run->parallel) < 0 )
+		return failed;
+
+	/* the data file is only used in the original, sequential mode */
+	return score(run, ctx, OPTIONS.deterministic ? NULL : run->datafile);
+}
+
+/*
+ * eval() of strategies[0..n-1], n <= LANES, as evaluations eval_ids[],
+ * into ctxs[] (one per strategy): their networks are trained together
+ * in 'lanes' (see lanes.h)
+ */
+void eval_lanes(struct run_t *run, struct eval_ctx_t **ctxs, struct lanes_t *lanes, 
+		char **strategies, unsigned long *eval_ids, int n, struct fitness_t *fitness) {
+	int i;
+
+	for ( i = 0 ; i < n ; i++ ) {
+		ctxs[i]->ann = NULL;
+		if ( simulate(run, ctxs[i], strategies[i], rng_key(run->seed, eval_ids[i]), 
+					OPTIONS.deterministic, run->parallel) < 0 )
+			ctxs[i]->strategy = NULL;
+	}
+	score_lanes(run, lanes, ctxs, n, fitness);
+}
+
+/* a batch of candidates going through the pipeline */
+struct batch_t {
+	struct run_t *run;
+	char **strategies;
+	int n;
+	int width;		/* candidates per item of the pipeline */
+	uint64_t *keys;
+	struct fitness_t *fitness;
+	scored_fn done;
+	void *arg;
+};
+
+/* the candidates of an item of the pipeline: LANES of them with -L, else one */
+struct group_t {
+	struct eval_ctx_t *ctx[LANES];
+	struct lanes_t lanes;
+};
+
+/*
+ * groups for the pipeline, passed from producers to consumers and
+ * back: there are enough for every thread plus a full queue, and they
+ * are kept from one batch to the next
+ */
+static pthread_mutex_t batch_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct queue_t *spare_groups = NULL;
+static struct group_t **batch_groups = NULL;
+static int num_batch_groups = 0;
+static int queued_groups = 0;
+static uint64_t *batch_keys = NULL;
+static unsigned int max_batch_keys = 0;
+
+/* pipeline producer: simulate the sessions of a group of candidates */
+static void *produce_samples(void *arg, int item, int thread) {
+	struct batch_t *batch = arg;
+	struct group_t *group;
+	int i, first = item * batch->width;
+
+	/* there is always one, eventually */
+	while ( (group = queue_pop(spare_groups)) == NULL )
+		sched_yield();
+
+	for ( i = first ; i < first + batch->width && i < batch->n ; i++ )
+		if ( simulate(batch->run, group->ctx[i - first], batch->strategies[i], 
+					batch->keys[i], 1, 0) < 0 )
+			group->ctx[i - first]->strategy = NULL;
+	return group;
+}
+
+/* pipeline consumer: train and test the networks of a group of candidates */
+static void consume_samples(void *arg, int item, void *product, int thread) {
+	struct batch_t *batch = arg;
+	struct group_t *group = product;
+	struct eval_ctx_t *ctx = group->ctx[0];
+	int i, first = item * batch->width;
+	int n = batch->n - first < batch->width ? batch->n - first : batch->width;
+
+	if ( batch->width > 1 ) {
+		score_lanes(batch->run, &group->lanes, group->ctx, n, &batch->fitness[first]);
+	} else if ( ctx->strategy != NULL ) {
+		batch->fitness[first] = score(batch->run, ctx, NULL);
+	} else {
+		memset(&batch->fitness[first], 0, sizeof(struct fitness_t));
+		batch->fitness[first].error = -1;
+		batch->fitness[first].failed = 1;
+	}
+
+	queue_push(spare_groups, group);
+
+	if ( batch->done != NULL )
+		for ( i = first ; i < first + n ; i++ )
+			batch->done(batch->arg, i, &batch->fitness[i]);
+}
 
-		/* apply strategy to new scenario, save results to memory */
-		if ( run_strategy_mem(strategy, run_scenario, results, input_neurones) < 0 ) {
-			fprintf(stderr, "Error in running strategy for testing\n");
+/*
+ * groups of 'width' contexts for the pipeline threads and queue;
+ * returns -1 on failure. Groups only go into the queue once they are
+ * all complete: on failure the queue keeps the groups it had, and the
+ * ones built so far are kept for the next call.
+ */
+static int prepare_batch_groups(int width) {
+	/* every thread holds one, and so does every slot of the queue */
+	int needed = pipe_threads() + pipe_depth() + 1, i, j;
+	struct group_t **groups;
+	struct queue_t *queue;
+
+	if ( num_batch_groups < needed ) {
+		groups = realloc(batch_groups, sizeof(struct group_t *) * needed);
+		if ( groups == NULL )
 			return -1;
+		batch_groups = groups;
+		for ( ; num_batch_groups < needed ; num_batch_groups++ ) {
+			batch_groups[num_batch_groups] = calloc(1, sizeof(struct group_t));
+			if ( batch_groups[num_batch_groups] == NULL )
+				return -1;
 		}
+	}
 
-		/* run the neural network on the new input */
-		network_output = fann_run(ann, results); 
+	for ( i = 0 ; i < num_batch_groups ; i++ ) {
+		for ( j = 0 ; j < width ; j++ ) {
+			if ( batch_groups[i]->ctx[j] == NULL )
+				batch_groups[i]->ctx[j] = create_context();
+			if ( batch_groups[i]->ctx[j] == NULL )
+				return -1;
+		}
+	}
 
-		/* compare the network output with the expected value */
-		expected_results[i] = fabs(run_scenario->nearest_object_centre - *network_output);
+	/* all the groups are back in between batches */
+	if ( queued_groups < num_batch_groups ) {
+		queue = queue_create(num_batch_groups);
+		if ( queue == NULL )
+			return -1;
+		for ( i = 0 ; i < num_batch_groups ; i++ )
+			queue_push(queue, batch_groups[i]);
+		queue_destroy(spare_groups);
+		spare_groups = queue;
+		queued_groups = num_batch_groups;
+	}
+
+	return 0;
+}
 
+/* free the groups of the pipeline, once it is stopped */
+void destroy_batch_groups() {
+	int i, j;
+
+	pthread_mutex_lock(&batch_lock);
+	for ( i = 0 ; i < num_batch_groups ; i++ ) {
+		for ( j = 0 ; j < LANES ; j++ )
+			destroy_context(batch_groups[i]->ctx[j]);
+		free_lanes(&batch_groups[i]->lanes);
+		free(batch_groups[i]);
 	}
+	free(batch_groups);
+	queue_destroy(spare_groups);
+	free(batch_keys);
+
+	batch_groups = NULL;
+	num_batch_groups = 0;
+	spare_groups = NULL;
+	queued_groups = 0;
+	batch_keys = NULL;
+	max_batch_keys = 0;
+	pthread_mutex_unlock(&batch_lock);
+}
 
-	fann_destroy(ann); 
-	destroy_scenario(run_scenario);
+/**
+ * evaluate a batch of strategies through the pipeline: while some
+ * threads train and test networks, others simulate the sessions of
+ * the next candidates.
+ *
+ * Candidate i is evaluation 'first_id + i'. In deterministic mode the
+ * results are the same as calling eval() on each of them; otherwise
+ * each candidate gets a key drawn, in order, from SFMT.
+ * With OPTIONS.lanes the candidates go through LANES at a time, their
+ * networks trained together, and eval_lanes() stands for eval() above.
+ * 'done' (if not NULL) is called from a pipeline thread as each
+ * candidate is scored.
+ */
+int eval_batch(struct run_t *run, char **strategies, int n, unsigned long first_id, 
+		struct fitness_t *fitness, scored_fn done, void *arg) {
+	struct batch_t batch;
+	int i;
 
-	/* TODO future fitness might include length, epochs, etc */
-	for ( i = 0 ; i < TESTING_SESSIONS ; i++ )
-		fitness += (float)expected_results[i];
-	fitness /= TESTING_SESSIONS;
+	pthread_mutex_lock(&batch_lock);
 
-	return fitness;
+	batch.width = OPTIONS.lanes ? LANES : 1;
+	if ( prepare_batch_groups(batch.width) < 0 
+			|| grow_buffer((void**)&batch_keys, &max_batch_keys, n, sizeof(uint64_t)) < 0 ) {
+		perror("Unable to allocate batch");
+		pthread_mutex_unlock(&batch_lock);
+		return -1;
+	}
+
+	batch.run = run;
+	batch.strategies = strategies;
+	batch.n = n;
+	batch.fitness = fitness;
+	batch.done = done;
+	batch.arg = arg;
+	batch.keys = batch_keys;
+
+	for ( i = 0 ; i < n ; i++ ) {
+		if ( OPTIONS.deterministic )
+			batch.keys[i] = rng_key(run->seed, first_id + i);
+		else
+			batch.keys[i] = ((uint64_t)gen_rand32() << 32) | gen_rand32();
+	}
+
+	pipe_run((n + batch.width - 1) / batch.width, produce_samples, consume_samples, &batch);
+
+	pthread_mutex_unlock(&batch_lock);
+	return 0;
 }
 
 /**
  * generate a strategy
  */
-static char* gen_strategy(int starting_len) {
+static char* gen_strategy(int starting_len, struct rng_t *rng) {
 	int i, num_cmds;
 
 	char* strategy = malloc(STRATEGY_MAX_LENGTH);
@@ -153,8 +765,8 @@ static char* gen_strategy(int starting_len) {
 
 	for ( i = 0 ; i < num_cmds*2 ;  ) {
 		/* all enums start from 1 */
-		strategy[i++] = gen_rand32() % NUM_ACTIONS + 1;
-		strategy[i++] = gen_rand32() % NUM_CONDITIONS + 1;
+		strategy[i++] = draw_u32(rng) % NUM_ACTIONS + 1;
+		strategy[i++] = draw_u32(rng) % NUM_CONDITIONS + 1;
 	}
 
 	return strategy;
@@ -167,240 +779,927 @@ inline static void print_strategy(char* strategy) {
 	printf("\n");
 }
 
-static void mutate(char* strategy) {
-	dbg("mutate\n");
+/*
+ * the operators: each one changes the loser into a new offspring
+ */
+
+/* add a random gene at the end */
+static void add_gene(char *strategy, struct rng_t *rng) {
+	size_t strategy_len = strlen(strategy);
+
+	trace(TR_OPERATOR, OP_ADD, strategy_len, 0, 0);
+	strategy[strategy_len] = draw_u32(rng) % NUM_ACTIONS + 1;
+	strategy[strategy_len+1] = draw_u32(rng) % NUM_CONDITIONS + 1;
+}
+
+/* remove the gene (action+condition) at 'locus', an action */
+static void remove_gene(char *strategy, int locus) {
+	trace(TR_OPERATOR, OP_REMOVE, locus, 0, 0);
+	/* nothing to remove at the end, never read past it */
+	while ( strategy[locus] != '\0' ) {
+		strategy[locus] = strategy[locus+2];
+		if ( strategy[locus] != '\0' )
+			strategy[locus+1] = strategy[locus+3];
+		locus += 2;
+	}
+}
+
+/* change the action or the condition at 'locus' */
+static void change_gene(char *strategy, int locus, struct rng_t *rng) {
+	trace(TR_OPERATOR, OP_CHANGE, locus, 0, 0);
+	if ( locus % 2 == 0 ) {
+		/* mutate action */
+		enum action_e new_action;
+		do {
+			new_action = draw_u32(rng) % NUM_ACTIONS + 1;
+		} while ( strategy[locus] == new_action );
+		strategy[locus] = new_action;
+	} else {
+		/* mutate condition */
+		enum condition_e new_condition;
+		do {
+			new_condition = draw_u32(rng) % NUM_CONDITIONS + 1;
+		} while ( strategy[locus] == new_condition );
+		strategy[locus] = new_condition;
+	}
+}
+
+/* add a gene from the winner to a random position in the loser */
+static void insert_gene(char* winner, char* loser, struct rng_t *rng) {
+	size_t winner_len = strlen(winner);
+	size_t loser_len = strlen(loser);
+	unsigned int locus, i;
+	enum action_e action;
+	enum condition_e condition;
+	int dest;
+
+	/* pick a gene from the winner */
+	locus = draw_u32(rng) % winner_len;
+
+	if ( locus % 2 == 0 ) {
+		/* if it's even it's an action:
+		 * must copy the subsequent condition (locus+1)
+		 */
+		action = winner[locus];
+		condition = winner[locus+1];
+	} else {
+		/* it's odd -> a condition: 
+		 * must copy the previous action (locus-1) 
+		 */
+		action = winner[locus-1];
+		condition = winner[locus];
+	}
+
+	/* pick a random position in the loser */
+	dest = draw_u32(rng) % loser_len;
+	/* make sure it's an action (even locus) */
+	dest = dest % 2 == 0 ? dest : dest+1;
+	trace(TR_OPERATOR, OP_INSERT, dest, 0, 0);
+
+	/* count backwards */
+	for ( i = loser_len ; i > dest ; i-- ) {
+		loser[i+2] = loser[i];
+	}
+	loser[dest] = action;
+	loser[dest+1] = condition;
+}
+
+/* copy an action OR a condition from the winner to the loser */
+static void copy_gene(char* winner, char* loser, struct rng_t *rng) {
+	unsigned int locus = draw_u32(rng) % strlen(winner);
+
+	trace(TR_OPERATOR, OP_COPY, locus, 0, 0);
+	/* since all genotypes have the same structure (action-condition)
+	 * it is guaranteed that the same kind of gene will be copied */
+	loser[locus] = winner[locus];
+}
+
+static void mutate(char* strategy, struct rng_t *rng) {
 	size_t strategy_len = strlen(strategy);
 
 	/* the mutation locus
 	 * could be inside the current genotype or outside */
-	int locus = gen_rand32() % STRATEGY_MAX_LENGTH;
+	int locus = draw_u32(rng) % STRATEGY_MAX_LENGTH;
 
 	/* if the locus is outside the current genotype
 	 * AND if there's still enough space (last byte is for null-terminating it) */
 	if ( locus > strategy_len && strategy_len < STRATEGY_MAX_LENGTH-3 ) {
-		/* add new gene (action+condition) */
-		strategy[strategy_len] = gen_rand32() % NUM_ACTIONS + 1;
-		strategy[strategy_len+1] = gen_rand32() % NUM_CONDITIONS + 1;
+		add_gene(strategy, rng);
 	} else {
 		/* mutate locally */
 
 		/* avoid mutating outside the current genotype;
 		 * chose a locus within the current individual */
-		if ( locus > strategy_len )
-			locus = gen_rand32() % strategy_len;
+		if ( locus >= strategy_len )
+			locus = draw_u32(rng) % strategy_len;
 
 		/* flip a coin: remove a (action+condition) gene or mutate? */
 		/* note: also check that the locus corresponds to an action and not a
-		 * condition */
-		if ( gen_rand32() % 2 == 0 && locus % 2 == 0 ) {
-			/* removing a gene (action+condition) */
-			do {
-				strategy[locus] = strategy[locus+2];
-				strategy[locus+1] = strategy[locus+3];
-				locus += 2;
-			} while ( strategy[locus] != '\0' );
-		} else {
-			/* mutating an existing gene */
-			if ( locus % 2 == 0 ) {
-				/* mutate action */
-				enum action_e new_action;
-				do {
-					new_action = gen_rand32() % NUM_ACTIONS + 1;
-				} while ( strategy[locus] == new_action );
-				strategy[locus] = new_action;
-			} else {
-				/* mutate condition */
-				enum condition_e new_condition;
-				do {
-					new_condition = gen_rand32() % NUM_CONDITIONS + 1;
-				} while ( strategy[locus] == new_condition );
-				strategy[locus] = new_condition;
-			}
-		}
+		 * condition, and never remove the last gene */
+		if ( draw_u32(rng) % 2 == 0 && locus % 2 == 0 && strategy_len > 2 )
+			remove_gene(strategy, locus);
+		else
+			change_gene(strategy, locus, rng);
 	}
 }
 
-static void cross_breed(char* winner, char* loser) {
-	dbg("cross/breed\n");
-	size_t winner_len = strlen(winner);
-	size_t loser_len = strlen(loser);
-	/* chose a locus within the shorter string */
-	unsigned int locus, i;
-	
-	int do_copy = 0;
-	
+static void cross_breed(char* winner, char* loser, struct rng_t *rng) {
 	/* if the loser is already near-full, must copy and not add */
 	/* important: keep -3 (because it could happen to make the loser bigger, etc
 	 * */
-	if ( loser_len >= STRATEGY_MAX_LENGTH-3 )
-		do_copy = 1;
+	if ( strlen(loser) < STRATEGY_MAX_LENGTH-3 && draw_u32(rng) % 2 == 0 )
+		insert_gene(winner, loser, rng);
+	else
+		copy_gene(winner, loser, rng);
+}
 
-	if ( do_copy == 0 && gen_rand32() % 2 == 0 ) {
+/*
+ * the operators on the network, with -N
+ */
 
-		/* adding a gene from the winner to the end of the loser or
-		 * to a random position in the loser */
+/* the network of a new strategy: as it would be without -N */
+static void default_topology(struct topology_t *t, char *strategy) {
+	t->hidden = get_input_neurones(strategy) + 5;
+	if ( t->hidden > MAX_HIDDEN )
+		t->hidden = MAX_HIDDEN;
+	t->activation = ACT_SIGMOID_STEPWISE;
+}
 
-		/* pick a gene from the winner */
-		locus = gen_rand32() % winner_len;
-		enum action_e action;
-		enum condition_e condition;
+/* grow or shrink the hidden layer, by up to a quarter */
+static void resize_hidden(struct topology_t *t, struct rng_t *rng) {
+	unsigned int step = 1 + draw_u32(rng) % (t->hidden / 4 + 1);
 
-		if ( locus % 2 == 0 ) {
-			/* if it's even it's an action:
-			 * must copy the subsequent condition (locus+1)
-			 */
-			action = winner[locus];
-			condition = winner[locus+1];
-		} else {
-			/* it's odd -> a condition: 
-			 * must copy the previous action (locus-1) 
-			 */
-			action = winner[locus-1];
-			condition = winner[locus];
-		}
+	if ( draw_u32(rng) % 2 == 0 && t->hidden > step )
+		t->hidden -= step;
+	else
+		t->hidden = t->hidden + step > MAX_HIDDEN ? MAX_HIDDEN : t->hidden + step;
+	trace(TR_OPERATOR, OP_RESIZE, t->hidden, 0, 0);
+}
 
-		/* pick a random position in the loser */
-		int dest = gen_rand32() % loser_len;
-		/* make sure it's an action (even locus) */
-		dest = dest % 2 == 0 ? dest : dest+1;
+static void change_activation(struct topology_t *t, struct rng_t *rng) {
+	t->activation = (t->activation + 1 + draw_u32(rng) % (NUM_ACTIVATIONS - 1)) 
+		% NUM_ACTIVATIONS;
+	trace(TR_OPERATOR, OP_ACTIVATION, t->activation, 0, 0);
+}
 
-		/* count backwards */
-		for ( i = loser_len ; i > dest ; i-- ) {
-			loser[i+2] = loser[i];
-		}
-		loser[dest] = action;
-		loser[dest+1] = condition;
-	} else {
-		/* copying a gene (action+condition) from winner to loser */
-		locus = gen_rand32() % winner_len;
+/* the network of the winner, for the strategy of the loser */
+static void adopt_topology(struct topology_t *winner, struct topology_t *loser) {
+	*loser = *winner;
+	trace(TR_OPERATOR, OP_ADOPT, loser->hidden, 0, 0);
+}
+
+/*
+ * the operators that can change the loser, as a mask of operator_e;
+ * those on its network if it has one
+ */
+static unsigned int operators_allowed(char *loser, struct topology_t *winner_topology, 
+		struct topology_t *loser_topology) {
+	size_t loser_len = strlen(loser);
+	unsigned int allowed = 1 << OP_CHANGE | 1 << OP_COPY;
+
+	if ( loser_len < STRATEGY_MAX_LENGTH-3 )
+		allowed |= 1 << OP_ADD | 1 << OP_INSERT;
+	/* never remove the last gene */
+	if ( loser_len > 2 )
+		allowed |= 1 << OP_REMOVE;
+	if ( loser_topology != NULL ) {
+		allowed |= 1 << OP_RESIZE | 1 << OP_ACTIVATION;
+		if ( memcmp(winner_topology, loser_topology, sizeof(struct topology_t)) != 0 )
+			allowed |= 1 << OP_ADOPT;
+	}
+	return allowed;
+}
+
+/* one operator, chosen instead of drawn by mutate() and cross_breed() */
+static void apply_operator(int op, char *winner, char *loser, 
+		struct topology_t *winner_topology, struct topology_t *loser_topology, 
+		struct rng_t *rng) {
+	size_t loser_len = strlen(loser);
+
+	switch ( op ) {
+		case OP_RESIZE:
+			resize_hidden(loser_topology, rng);
+			break;
+		case OP_ACTIVATION:
+			change_activation(loser_topology, rng);
+			break;
+		case OP_ADOPT:
+			adopt_topology(winner_topology, loser_topology);
+			break;
+		case OP_ADD:
+			add_gene(loser, rng);
+			break;
+		case OP_REMOVE:
+			remove_gene(loser, 2 * (draw_u32(rng) % (loser_len / 2)));
+			break;
+		case OP_CHANGE:
+			change_gene(loser, draw_u32(rng) % loser_len, rng);
+			break;
+		case OP_INSERT:
+			insert_gene(winner, loser, rng);
+			break;
+		default:
+			copy_gene(winner, loser, rng);
+			break;
+	}
+}
+
+/* room for at least 'max' strategies; returns -1 on failure */
+int create_population(struct population_t *p, size_t max) {
+	memset(p, 0, sizeof(struct population_t));
+	if ( hcreate_r(max, &p->table) == 0 )
+		return -1;
+	return 0;
+}
+
+void destroy_population(struct population_t *p) {
+	hdestroy_r(&p->table);
+	while ( p->size > 0 )
+		free(p->members[--p->size]);
+	free(p->members);
+	p->members = NULL;
+	p->max = 0;
+}
+
+/*
+ * the key of a strategy in the population: its canonical form, then
+ * with -N a byte no gene takes and its network; 'key' has room for
+ * MEMBER_KEY_EXTRA more bytes than the strategy
+ */
+#define MEMBER_KEY_EXTRA 4
+static void member_key(char *key, char *strategy, struct topology_t *t) {
+	size_t len;
+
+	canonical_strategy(key, strategy);
+	if ( t == NULL )
+		return;
+	len = strlen(key);
+	key[len] = 0x7f;
+	key[len+1] = t->hidden;
+	key[len+2] = t->activation + 1;
+	key[len+3] = '\0';
+}
+
+/* the member a strategy (with its network) is equivalent to, or NULL */
+static struct member_t *find_member(struct population_t *p, char *strategy, 
+		struct topology_t *t) {
+	char key[strlen(strategy) + MEMBER_KEY_EXTRA];
+	ENTRY item, *found;
+
+	member_key(key, strategy, t);
+	item.key = key;
+	item.data = NULL;
+	if ( hsearch_r(item, FIND, &found, &p->table) == 0 )
+		return NULL;
+	return found->data;
+}
+
+/* 1 if the strategy, or an equivalent one, has already been evaluated */
+static int evaluated(struct population_t *p, char *strategy, struct topology_t *t) {
+	return find_member(p, strategy, t) != NULL;
+}
+
+/* 
+ * add a strategy to the population, if no equivalent one is there 
+ * already; returns -1 if it is full
+ */
+static int add_strategy(struct population_t *p, char *strategy, struct topology_t *t) {
+	struct member_t *m;
+	ENTRY item, *found;
 
-		/* copy the action OR condition from the winner to the loser;
-		 * since all genotypes have the same structure (action-condition)
-		 * it is guaranteed that the same kind of gene will be copied */
-		loser[locus] = winner[locus];
+	if ( evaluated(p, strategy, t) )
+		return 0;
+	if ( grow_buffer((void**)&p->members, &p->max, p->size + 1, sizeof(struct member_t*)) < 0 )
+		return -1;
+
+	m = calloc(1, sizeof(struct member_t) + strlen(strategy) + MEMBER_KEY_EXTRA);
+	if ( m == NULL )
+		return -1;
+	member_key(m->key, strategy, t);
+	item.key = m->key;
+	item.data = m;
+	if ( hsearch_r(item, ENTER, &found, &p->table) == 0 ) {
+		free(m);
+		return -1;
 	}
+	p->members[p->size++] = m;
+	return 0;
+}
+
+/* keep the fitness of a strategy for the equivalent ones */
+static void remember_fitness(struct population_t *p, char *strategy, struct topology_t *t, 
+		struct fitness_t *fitness) {
+	struct member_t *m = find_member(p, strategy, t);
+
+	if ( m == NULL )
+		return;
+	m->fitness = *fitness;
+	m->scored = 1;
+}
+
+/* 
+ * the fitness of the strategy (with its network, or the default one if
+ * NULL), measured on an equivalent one, or evaluated now (and
+ * remembered) if there is none
+ */
+static struct fitness_t shared_eval(struct run_t *run, struct population_t *p, 
+		struct eval_ctx_t *ctx, char *strategy, struct topology_t *t, 
+		unsigned long *evaluations) {
+	struct member_t *m = find_member(p, strategy, t);
+	struct fitness_t fitness;
+
+	if ( m != NULL && m->scored )
+		return m->fitness;
+
+	ctx->topology = t;
+	fitness = eval(run, ctx, strategy, (*evaluations)++);
+	ctx->topology = NULL;
+	remember_fitness(p, strategy, t, &fitness);
+	return fitness;
 }
 
 /*
- * mutate or cross-breed strategies
+ * shared_eval() of an offspring, its network started from the weights
+ * of its parent (or NULL); the weights it is trained to are kept in
+ * 'kept' for its own offspring. 'kept' may be 'parent': it is only
+ * written once the network is trained.
  */
-static int mutate_breed(char* winner, char* loser) {
-	ENTRY item;
+static struct fitness_t warm_eval(struct run_t *run, struct population_t *p, 
+		struct eval_ctx_t *ctx, char *strategy, struct topology_t *t, 
+		struct warm_t *parent, struct warm_t *kept, unsigned long *evaluations) {
+	unsigned long before = *evaluations;
+	struct fitness_t fitness;
+
+	ctx->warm = parent != NULL && parent->num_weights > 0 ? parent : NULL;
+	fitness = shared_eval(run, p, ctx, strategy, t, evaluations);
+	ctx->warm = NULL;
+
+	/* a remembered fitness trains no network */
+	if ( *evaluations == before || ctx->ann == NULL 
+			|| keep_weights(kept, ctx->ann, strategy) < 0 )
+		kept->num_weights = 0;
+	return fitness;
+}
 
-	size_t winner_len, loser_len;
-	winner_len = strlen(winner);
-	loser_len = strlen(loser);
+/*
+ * change the loser until it is new to the population, with the operator
+ * the bandit chooses, or else mutate or cross-breed it, or with -N
+ * change its network now and then (draws from 'rng', or from SFMT when
+ * NULL). The topologies are NULL without -N.
+ * Returns the operator of the offspring (NUM_OPERATORS for mutate() and
+ * cross_breed()), -1 if no new strategy can be bred.
+ */
+static int breed(struct population_t *population, char* winner, 
+		struct topology_t *winner_topology, char* loser, struct topology_t *loser_topology, 
+		struct bandit_t *bandit, struct rng_t *rng) {
+	int attempts = 0, op = NUM_OPERATORS;
 
-	/* might loop forever if population is already full-1 (?) */
+	/* equivalent offspring are not new: give up when none is left */
 	do {
-		if ( genrand_real3() > PROB_MUT ) {
+		if ( attempts++ == MAX_BREED_ATTEMPTS ) {
+			fprintf(stderr, "No new strategy after %d attempts\n", MAX_BREED_ATTEMPTS);
+			return -1;
+		}
+		op = NUM_OPERATORS;
+		if ( bandit != NULL ) {
+			op = bandit_choose(bandit, operators_allowed(loser, winner_topology, 
+						loser_topology), rng);
+			apply_operator(op, winner, loser, winner_topology, loser_topology, rng);
+		} else if ( loser_topology != NULL && draw_real3(rng) < PROB_TOPOLOGY ) {
+			op = OP_RESIZE + draw_u32(rng) % (NUM_OPERATORS - OP_RESIZE);
+			apply_operator(op, winner, loser, winner_topology, loser_topology, rng);
+		} else if ( draw_real3(rng) > PROB_MUT ) {
 			/* mutate */
-			mutate(loser);
+			mutate(loser, rng);
 		} else {
 			/* cross-breed */
-			cross_breed(winner, loser);
+			cross_breed(winner, loser, rng);
 		}
 
 		/* be sure that the new individual has not been already evaluated */
-		item.key = strdup(loser);
-	} while ( hsearch(item, FIND) != NULL );
-	dbg("new individual found\n");
+	} while ( evaluated(population, loser, loser_topology) );
+	trace(TR_OFFSPRING, 0, strlen(loser), 0, 0);
 
 	/* insert new item into hash table */
-	if ( hsearch(item, ENTER) == NULL ) {
+	if ( add_strategy(population, loser, loser_topology) < 0 ) {
 		perror("Population limit reached");
 		return -1;
 	}
-	return 0;
+	return op;
+}
+
+/* 
+ * the error, plus the penalty for running out of steps, and with -N the
+ * cost of the network
+ */
+static float penalised(struct fitness_t *f) {
+	return f->error + BUDGET_PENALTY * f->over_budget 
+		+ OPTIONS.model_weight * f->connections;
+}
+
+/* 1 if 'a' is no worse than 'b' on every objective, and better on one */
+static int dominates(struct fitness_t *a, struct fitness_t *b) {
+	if ( penalised(a) > penalised(b) || a->steps > b->steps || a->length > b->length )
+		return 0;
+	return penalised(a) < penalised(b) || a->steps < b->steps || a->length < b->length;
+}
+
+static float weighted(struct fitness_t *f) {
+	return penalised(f) + OPTIONS.steps_weight * f->steps + OPTIONS.length_weight * f->length;
+}
+
+/* 
+ * what strategies are ranked by, lower is better: the weighted sum for 
+ * the weighted objective, the penalised error otherwise
+ */
+float rank_value(struct fitness_t *fitness) {
+	if ( OPTIONS.objective == OBJ_WEIGHTED )
+		return weighted(fitness);
+	return penalised(fitness);
 }
 
 /*
- * main evolutionary algorithm, using a variant of the microbial GA
+ * rank_value() less the cost of the network (-N): what the surrogate
+ * learns and predicts, as it only knows the genes
  */
-void evolve (char* datafile, int generations, unsigned int max_epochs, float desired_error, 
-		int strategy_max_len, int strategy_starting_len, 
-		int training_sessions, int testing_sessions) {
+static float strategy_value(struct fitness_t *fitness) {
+	return rank_value(fitness) - OPTIONS.model_weight * fitness->connections;
+}
 
-	/* set global variables */
-	DESIRED_ERROR = desired_error;
-	/* must be even, last byte is \0 for terminating string */
-	STRATEGY_MAX_LENGTH = strategy_max_len % 2 == 0 
-		? strategy_max_len+1 : strategy_max_len;
-	MAX_EPOCHS = max_epochs;
+/*
+ * tournament between two evaluated strategies, according to the
+ * objective: returns 1 if the first one wins
+ */
+static int wins(struct fitness_t *a, struct fitness_t *b, struct rng_t *rng) {
+	switch (OPTIONS.objective) {
+		case OBJ_WEIGHTED:
+			return weighted(a) < weighted(b);
+		case OBJ_PARETO:
+			if ( dominates(a, b) )
+				return 1;
+			if ( dominates(b, a) )
+				return 0;
+			/* neither is better: either can win */
+			return draw_u32(rng) % 2 == 0;
+		default:
+			/* technically is not a fitness, but an error measure */
+			return penalised(a) < penalised(b);
+	}
+}
+
+/*
+ * breed the loser again while the surrogate predicts it loses to the
+ * winner, unless it is explored all the same; returns the operator of
+ * the offspring kept ('op' if it is the first one), -1 if no new
+ * strategy can be bred. The surrogate only knows strategies: an
+ * offspring with a new network is always evaluated.
+ */
+static int screen_offspring(struct run_t *run, struct population_t *population, 
+		struct surrogate_t *surrogate, struct bandit_t *bandit, char *winner, 
+		struct topology_t *winner_topology, struct fitness_t *winner_fitness, 
+		char *loser, struct topology_t *loser_topology, int op, struct rng_t *rng) {
+	float parent = strategy_value(winner_fitness);
+	int skips;
+
+	if ( surrogate_ready(surrogate) == 0 )
+		return op;
+	for ( skips = 0 ; skips < SURROGATE_MAX_SKIPS ; skips++ ) {
+		if ( (op >= OP_RESIZE && op < NUM_OPERATORS) 
+				|| surrogate_predict(surrogate, loser) < parent 
+				|| draw_real3(rng) < OPTIONS.exploration )
+			return op;
+		/* never evaluated, it stays in the population as seen */
+		run->screened++;
+		op = breed(population, winner, winner_topology, loser, loser_topology, 
+				bandit, rng);
+		if ( op < 0 )
+			return -1;
+	}
+	return op;
+}
 
-	TRAINING_SESSIONS = training_sessions;
-	TESTING_SESSIONS = testing_sessions;
+static const char *OPERATOR_NAMES[NUM_OPERATORS] = 
+	{ "add", "remove", "change", "insert", "copy", "resize", "activation", "adopt" };
 
+/* CPU time of the process, over all its threads */
+static double cpu_seconds() {
+	struct timespec now;
+
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/*
+ * reward the operator that bred an offspring, from its fitness and that
+ * of the loser it was bred from. The cost is the CPU time of its
+ * evaluation; in deterministic mode, where that would make the run
+ * depend on the machine, it is the work of training and testing its
+ * network instead (epochs times sessions times connections).
+ */
+static void reward_operator(struct run_t *run, struct bandit_t *bandit, int op, 
+		struct eval_ctx_t *ctx, struct fitness_t *offspring, struct fitness_t *parent, 
+		struct fitness_t *winner, double started) {
+	double cost;
+
+	/* nothing was learnt from a failed evaluation */
+	if ( offspring->failed || ctx->ann == NULL )
+		return;
+	if ( OPTIONS.deterministic )
+		cost = ((double)offspring->epochs * run->training_sessions + run->testing_sessions) 
+			* fann_get_total_connections(ctx->ann);
+	else
+		cost = cpu_seconds() - started;
+	bandit_reward(bandit, op, rank_value(parent) - rank_value(offspring), cost, 
+			rank_value(offspring) < rank_value(winner));
+}
+
+/* what a run spent, whichever way it ends */
+static void account_run(struct run_t *run, unsigned long evaluations, 
+		struct timespec *start, double cpu_start) {
+	struct timespec end;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	run->evaluations = evaluations;
+	run->seconds = end.tv_sec - start->tv_sec + (end.tv_nsec - start->tv_nsec) / 1e9;
+	run->cpu_seconds = cpu_seconds() - cpu_start;
+}
+
+/*
+ * note the targets an evaluated strategy reached first; returns 1 once
+ * they are all reached
+ */
+static int reach_targets(struct run_t *run, struct fitness_t *fitness, 
+		unsigned long evaluations, struct timespec *start, double cpu_start) {
+	struct timespec now;
+	int i, left = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	for ( i = 0 ; i < run->num_targets ; i++ ) {
+		struct target_t *t = &run->targets[i];
+
+		if ( t->reached == 0 && !fitness->failed && fitness->error <= t->error ) {
+			t->reached = 1;
+			t->seconds = now.tv_sec - start->tv_sec 
+				+ (now.tv_nsec - start->tv_nsec) / 1e9;
+			t->cpu_seconds = cpu_seconds() - cpu_start;
+			t->evaluations = evaluations;
+		}
+		left += t->reached == 0;
+	}
+	return left == 0;
+}
+
+/* keep the non-dominated strategies of the run, in pareto mode */
+static void update_front(struct run_t *run, char *strategy, struct fitness_t *fitness) {
+	struct front_t *front = run->front;
+	int i, j;
+
+	for ( i = 0 ; i < run->front_size ; i++ )
+		if ( dominates(&front[i].fitness, fitness) 
+				|| strcmp(front[i].strategy, strategy) == 0 )
+			return;
+
+	/* drop what the new strategy dominates */
+	for ( i = 0, j = 0 ; i < run->front_size ; i++ ) {
+		if ( dominates(fitness, &front[i].fitness) )
+			free(front[i].strategy);
+		else
+			front[j++] = front[i];
+	}
+	run->front_size = j;
+
+	/* when full, the front keeps its most accurate members */
+	if ( run->front_size == FRONT_SIZE ) {
+		for ( i = 0, j = 0 ; i < run->front_size ; i++ )
+			if ( front[i].fitness.error > front[j].fitness.error )
+				j = i;
+		if ( front[j].fitness.error <= fitness->error )
+			return;
+		free(front[j].strategy);
+		front[j] = front[--run->front_size];
+	}
+
+	/* full length, for print_strategy() */
+	front[run->front_size].strategy = calloc(STRATEGY_MAX_LENGTH, 1);
+	if ( front[run->front_size].strategy == NULL )
+		return;
+	strcpy(front[run->front_size].strategy, strategy);
+	front[run->front_size].fitness = *fitness;
+	run->front_size++;
+}
+
+static void print_fitness(char *name, struct fitness_t *fitness, char *strategy) {
+	if ( OPTIONS.topology && OPTIONS.objective == OBJ_ERROR )
+		printf("%s (fitness %f, over budget %.0f%%, %u connections): ", name, 
+				fitness->error, 100 * fitness->over_budget, fitness->connections);
+	else if ( OPTIONS.objective == OBJ_ERROR && fitness->over_budget == 0 )
+		printf("%s (fitness %f): ", name, fitness->error);
+	else if ( OPTIONS.objective == OBJ_ERROR )
+		printf("%s (fitness %f, over budget %.0f%%): ", name, 
+				fitness->error, 100 * fitness->over_budget);
+	else
+		printf("%s (fitness %f, steps %.1f, length %d, over budget %.0f%%): ", name, 
+				fitness->error, fitness->steps, fitness->length, 100 * fitness->over_budget);
+	print_strategy(strategy);
+}
+
+/* 
+ * save the histogram of steps per testing session: 
+ * "<steps> <sessions>" per line, the last line counts anything longer
+ */
+static int save_histogram(struct run_t *run, char *filename) {
+	FILE *f;
+	int i;
+
+	f = fopen(filename, "w");
+	if ( f == NULL ) {
+		perror("Unable to open histogram file");
+		return -1;
+	}
+	fprintf(f, "# steps sessions (action budget %u, strategy budget %u)\n", 
+			BUDGET.action_steps, BUDGET.strategy_steps);
+	for ( i = 0 ; i < HISTOGRAM_BINS ; i++ )
+		if ( run->histogram[i] > 0 )
+			fprintf(f, "%s%d %lu\n", i == HISTOGRAM_BINS - 1 ? ">=" : "", 
+					i, run->histogram[i]);
+
+	if ( fclose(f) != 0 ) {
+		perror("Unable to close histogram file");
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * main evolutionary algorithm, using a variant of the microbial GA.
+ * Returns -1 if the run could not go through all its generations.
+ */
+int evolve(struct run_t *run) {
 	char *strategy1, *strategy2;
-	float fit1 = -1.0, fit2 = -1.0;
-	ENTRY item1, item2;
-	int winner;
+	struct fitness_t fit1 = { -1.0, 0, 0, 0, 0, 0, 1 }, fit2 = { -1.0, 0, 0, 0, 0, 0, 1 };
+	struct population_t population;
+	int i, winner, batched = 0, generations = run->generations, ret = -1;
+	/* logical work items, what keyed draws are derived from */
+	unsigned long evaluations = 0, generation = 0;
+	struct rng_t breed_rng, *rng = NULL;
+	struct eval_ctx_t *ctx;
+	/* the trained weights of strategy1 and strategy2, with -w */
+	struct warm_t warm[2];
+	/* their networks with -N, NULL otherwise */
+	struct topology_t topology[2], *t1 = NULL, *t2 = NULL;
+	struct surrogate_t surrogate;
+	/* with -A: the operator of the offspring to evaluate, the loser it
+	 * was bred from, and when its evaluation started */
+	struct bandit_t operators, *bandit = NULL;
+	struct fitness_t bred_from;
+	int op = -1;
+	double started = 0, cpu_start = cpu_seconds();
+	struct timespec start;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	memset(warm, 0, sizeof(warm));
+	if ( OPTIONS.adaptive ) {
+		init_bandit(&operators, OPTIONS.topology ? NUM_OPERATORS : NUM_STRATEGY_OPERATORS, 
+				OPERATOR_NAMES);
+		bandit = &operators;
+	}
+
+	/* must be even, last byte is \0 for terminating string */
+	STRATEGY_MAX_LENGTH = run->max_len % 2 == 0 
+		? run->max_len+1 : run->max_len;
 
-	if ( strategy_starting_len > strategy_max_len ) {
+	if ( run->starting_len > run->max_len ) {
 		fprintf(stderr,"Starting length bigger than max length\n");
-		return;
+		account_run(run, evaluations, &start, cpu_start);
+		return -1;
+	}
+
+	/* initialise population */
+	if ( create_population(&population, run->popsize) < 0 ) {
+		perror("Unable to allocate population");
+		account_run(run, evaluations, &start, cpu_start);
+		return -1;
+	}
+
+	if ( OPTIONS.deterministic ) {
+		rng_init(&breed_rng, rng_key(rng_key(run->seed, KEY_BREEDING), generation));
+		rng = &breed_rng;
+	}
+
+	ctx = create_context();
+	if ( ctx == NULL ) {
+		destroy_population(&population);
+		account_run(run, evaluations, &start, cpu_start);
+		return -1;
+	}
+	memset(&surrogate, 0, sizeof(surrogate));
+	if ( OPTIONS.surrogate && create_surrogate(&surrogate) < 0 ) {
+		perror("Unable to allocate the surrogate");
+		destroy_context(ctx);
+		destroy_population(&population);
+		account_run(run, evaluations, &start, cpu_start);
+		return -1;
 	}
 
 	/* generate two random strategies (allocate mem)*/
-	strategy1 = gen_strategy(strategy_starting_len);
-	strategy2 = gen_strategy(strategy_starting_len);
+	strategy1 = gen_strategy(run->starting_len, rng);
+	strategy2 = gen_strategy(run->starting_len, rng);
+	if ( OPTIONS.topology ) {
+		default_topology(&topology[0], strategy1);
+		default_topology(&topology[1], strategy2);
+		t1 = &topology[0];
+		t2 = &topology[1];
+	}
 	
 	/* put strategies in population */
-	item1.key = strdup(strategy1);
-	item2.key = strdup(strategy2);
-	if ( hsearch(item1, ENTER) == NULL 
-			|| hsearch(item2, ENTER) == NULL ) {
+	if ( add_strategy(&population, strategy1, t1) < 0 
+			|| add_strategy(&population, strategy2, t2) < 0 ) {
 		perror("Population limit reached");
-		return;
+		goto out;
 	}
 
 	winner = 0;
+
+	/* the first pair is a batch: overlap simulation and training
+	 * (only when it cannot change the results, keeps no weights, and
+	 * the networks are the default ones). It is the only batch: after
+	 * it a generation makes one offspring, bred from the winner of the
+	 * pair before, so there is nothing to evaluate alongside it */
+	if ( OPTIONS.deterministic && run->parallel && OPTIONS.warm_start == 0 
+			&& OPTIONS.topology == 0 ) {
+		char *first[2] = { strategy1, strategy2 };
+		struct fitness_t fit[2];
+
+		eval_batch(run, first, 2, evaluations, fit, NULL, NULL);
+		evaluations += 2;
+		fit1 = fit[0];
+		fit2 = fit[1];
+		remember_fitness(&population, strategy1, NULL, &fit1);
+		remember_fitness(&population, strategy2, NULL, &fit2);
+		batched = 1;
+	}
+
 	/* evaluate their fitness */
 	do {
+		if ( op >= 0 )
+			started = cpu_seconds();
+
 		/* avoid checking already-checked strategies */
-		if ( winner != 1 )
-			fit1 = eval(strategy1, datafile);
-		if ( winner != 2 )
-			fit2 = eval(strategy2, datafile);
+		if ( OPTIONS.warm_start ) {
+			/*
+			 * the offspring is the loser changed in place: it starts
+			 * from the network the loser was trained to, still in its
+			 * slot, which differs from it by the one change
+			 */
+			if ( winner != 1 )
+				fit1 = warm_eval(run, &population, ctx, strategy1, t1, 
+						winner == 2 ? &warm[0] : NULL, &warm[0], &evaluations);
+			if ( winner != 2 )
+				fit2 = warm_eval(run, &population, ctx, strategy2, t2, 
+						winner == 1 ? &warm[1] : NULL, &warm[1], &evaluations);
+		} else {
+			if ( winner != 1 && batched == 0 )
+				fit1 = shared_eval(run, &population, ctx, strategy1, t1, &evaluations);
+			if ( winner != 2 && batched == 0 )
+				fit2 = shared_eval(run, &population, ctx, strategy2, t2, &evaluations);
+		}
+		batched = 0;
 
-		if ( generations-- == 0 )
+		if ( op >= 0 ) {
+			reward_operator(run, bandit, op, ctx, winner == 1 ? &fit2 : &fit1, 
+					&bred_from, winner == 1 ? &fit1 : &fit2, started);
+			op = -1;
+		}
+
+		/* what the surrogate learns from: evaluations that were made */
+		if ( OPTIONS.surrogate ) {
+			if ( winner != 1 && !fit1.failed )
+				surrogate_observe(&surrogate, strategy1, strategy_value(&fit1));
+			if ( winner != 2 && !fit2.failed )
+				surrogate_observe(&surrogate, strategy2, strategy_value(&fit2));
+		}
+
+		if ( OPTIONS.objective == OBJ_PARETO ) {
+			if ( !fit1.failed )
+				update_front(run, strategy1, &fit1);
+			if ( !fit2.failed )
+				update_front(run, strategy2, &fit2);
+		}
+
+		if ( run->num_targets > 0 ) {
+			reach_targets(run, &fit1, evaluations, &start, cpu_start);
+			if ( reach_targets(run, &fit2, evaluations, &start, cpu_start) ) {
+				ret = 0;
 				break;
+			}
+		}
+
+		if ( generations-- == 0 ) {
+			ret = 0;
+			break;
+		}
 
-		printf("Strategy1 (fitness %f): ", fit1);
-		print_strategy(strategy1);
-		printf("Strategy2 (fitness %f): ", fit2);
-		print_strategy(strategy2);
+		if ( run->verbose ) {
+			print_fitness("Strategy1", &fit1, strategy1);
+			print_fitness("Strategy2", &fit2, strategy2);
+		}
 
-		if ( fit1 < 0 || fit2 < 0 )
+		if ( fit1.failed || fit2.failed ) {
 			/* problem in memory allocation, etc */
-			return;
+			goto out;
+		}
 
-		/* technically is not a fitness, but an error measure */
-		if ( fit1 < fit2 ) {
+		if ( OPTIONS.deterministic )
+			rng_init(&breed_rng, rng_key(rng_key(run->seed, KEY_BREEDING), ++generation));
+
+		if ( wins(&fit1, &fit2, rng) ) {
 			winner = 1;
+			bred_from = fit2;
 			/* mutate or breed */
-			if ( mutate_breed(strategy1, strategy2) < 0 )
-				break;
+			op = breed(&population, strategy1, t1, strategy2, t2, bandit, rng);
+			if ( op >= 0 && OPTIONS.surrogate )
+				op = screen_offspring(run, &population, &surrogate, bandit, 
+						strategy1, t1, &fit1, strategy2, t2, op, rng);
 		} else {
 			winner = 2;
+			bred_from = fit1;
 			/* note: it does mutate if they are equivalent.. */
-			if ( mutate_breed(strategy2, strategy1) < 0 )
-				break;
+			op = breed(&population, strategy2, t2, strategy1, t1, bandit, rng);
+			if ( op >= 0 && OPTIONS.surrogate )
+				op = screen_offspring(run, &population, &surrogate, bandit, 
+						strategy2, t2, &fit2, strategy1, t1, op, rng);
 		}
-		printf("\n");
+		if ( op < 0 )
+			break;
+		if ( bandit == NULL )
+			op = -1;
+		if ( run->verbose )
+			printf("\n");
 	} while ( 1 );	/* break if generations == 0 */
 
-	/* print the current best strategy upon quit*/
-	printf("Current best strategy: ");
-	if ( winner == 1 ) 
-		print_strategy(strategy1);
-	else if ( winner == 2 ) 
-		print_strategy(strategy2);
-	else
-		printf("No strategy\n");
+	/* keep the current best strategy */
+	if ( winner != 0 ) {
+		run->best = calloc(STRATEGY_MAX_LENGTH, 1);
+		if ( run->best != NULL )
+			strcpy(run->best, winner == 1 ? strategy1 : strategy2);
+		run->best_fitness = winner == 1 ? fit1 : fit2;
+		if ( OPTIONS.topology )
+			run->best_topology = topology[winner - 1];
+	}
+
+	if ( run->verbose ) {
+		/* print the current best strategy upon quit*/
+		if ( OPTIONS.validation > 0 )
+			printf("Training epochs: %lu in %lu evaluations\n", run->epochs, evaluations);
+		if ( OPTIONS.surrogate )
+			printf("Offspring screened out: %lu\n", run->screened);
+		if ( bandit != NULL )
+			print_bandit(bandit, OPTIONS.deterministic ? "work" : "cpu_seconds");
+
+		printf("Current best strategy: ");
+		if ( winner == 1 ) 
+			print_strategy(strategy1);
+		else if ( winner == 2 ) 
+			print_strategy(strategy2);
+		else
+			printf("No strategy\n");
+		if ( OPTIONS.topology && winner != 0 )
+			printf("Its network: %u hidden neurons, %s activation, %u connections\n", 
+					run->best_topology.hidden, 
+					ACTIVATION_NAMES[run->best_topology.activation], 
+					run->best_fitness.connections);
+
+		if ( OPTIONS.histogram != NULL )
+			save_histogram(run, OPTIONS.histogram);
+
+		if ( OPTIONS.objective == OBJ_PARETO ) {
+			printf("Pareto front (%d strategies):\n", run->front_size);
+			for ( i = 0 ; i < run->front_size ; i++ )
+				print_fitness("  ", &run->front[i].fitness, run->front[i].strategy);
+		}
+	}
 
+out:
+	account_run(run, evaluations, &start, cpu_start);
 	free(strategy1);
 	free(strategy2);
+	free_warm(&warm[0]);
+	free_warm(&warm[1]);
+	destroy_surrogate(&surrogate);
+	destroy_context(ctx);
+	destroy_population(&population);
+	return ret;
+}
+
+/* free what a run kept of its results */
+void free_run(struct run_t *run) {
+	int i;
+
+	free(run->best);
+	run->best = NULL;
+	for ( i = 0 ; i < run->front_size ; i++ )
+		free(run->front[i].strategy);
+	run->front_size = 0;
 }
 
 
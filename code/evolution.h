@@ -4,22 +4,101 @@
 #include <string.h>
 #include <search.h>
 #include <assert.h>
+#include <signal.h>
 
 #include "scenario.h"
+#include "corpus.h"
 
-/* for manual interrupts */
-short keep_going;
+/* for manual interrupts: cleared to stop what is going on */
+extern volatile sig_atomic_t keep_going;
+
+/* run-time options, set from the command line */
+struct options_t {
+	int threads;		/* threads used to simulate sessions */
+	int deterministic;	/* key every random draw to its work item */
+	int producers;		/* pipeline threads simulating sessions */
+	int objective;		/* how strategies are compared, see objective_e */
+	float steps_weight;	/* weighted objective: cost of a step */
+	float length_weight;	/* weighted objective: cost of a gene */
+	char *histogram;	/* where to save the histogram of steps, or NULL */
+	struct corpus_t *corpus;	/* where scenarios come from, NULL to generate them */
+	int warm_start;		/* offspring start from the weights of their parent */
+	float validation;	/* share of training sessions held out to stop early, 0 for none */
+	unsigned int check_every;	/* epochs between validation checks */
+	unsigned int patience;	/* checks without improvement before stopping */
+	int sharded_training;	/* train each network on all the threads */
+	int surrogate;		/* screen offspring with a surrogate of the fitness */
+	float exploration;	/* chance a predicted loser is evaluated all the same */
+	int adaptive;		/* choose the operators by what they paid off, see bandit.h */
+	int topology;		/* co-evolve the network of every strategy, see topology_t */
+	float model_weight;	/* cost of a connection of the network, in the error */
+	int lanes;		/* train the networks of a batch together, see lanes.h */
+};
+extern struct options_t OPTIONS;
+
+/* 
+ * OBJ_ERROR: prediction error only (the original)
+ * OBJ_WEIGHTED: error + steps_weight * steps + length_weight * genes
+ * OBJ_PARETO: a strategy wins if it dominates on (error, steps, genes), 
+ * a coin is flipped otherwise
+ */
+enum objective_e { OBJ_ERROR = 0, OBJ_WEIGHTED, OBJ_PARETO };
+
+/* what an evaluation measures */
+struct fitness_t {
+	float error;	/* mean error of the network, from -1 (it can be negative) */
+	float steps;	/* mean steps (lateral + angular) per testing session */
+	int length;	/* genes in the strategy */
+	float over_budget;	/* share of testing sessions out of step budget */
+	unsigned int epochs;	/* the network was trained for */
+	unsigned int connections;	/* of the network: its cost, to train and to run */
+	int failed;	/* the evaluation failed: nothing above is valid */
+};
+
+/*
+ * the network of a strategy, evolved with it (-N): its hidden neurons
+ * and their activation. Otherwise the network has inputs + 5 hidden
+ * neurons, with the default activation of FANN.
+ */
+enum activation_e { ACT_SIGMOID_STEPWISE = 0, ACT_ELLIOT, NUM_ACTIVATIONS };
+#define MAX_HIDDEN 120		/* fits a byte of the population keys */
+struct topology_t {
+	unsigned int hidden;
+	int activation;		/* see activation_e */
+};
 
 /* GA params */
 static const float PROB_MUT = 0.5;
 static const float PROB_X = 0.05;
+/* 
+ * the operators mutate() and cross_breed() choose from, that the
+ * adaptive mode chooses between directly; then those that change the
+ * topology of the network, with -N
+ */
+enum operator_e { OP_ADD = 0, OP_REMOVE, OP_CHANGE, OP_INSERT, OP_COPY, 
+	OP_RESIZE, OP_ACTIVATION, OP_ADOPT, NUM_OPERATORS };
+#define NUM_STRATEGY_OPERATORS OP_RESIZE
+/* with -N, the chance an offspring is bred by changing its network */
+static const float PROB_TOPOLOGY = 0.2;
+/* offspring tried before the search space is considered exhausted */
+static const int MAX_BREED_ATTEMPTS = 100000;
+/* added to the error for running out of step budget in every session */
+static const float BUDGET_PENALTY = 1.0;
+
+/* histogram of steps per session: one bin per step, the last one for more */
+#define HISTOGRAM_BINS 256
 
 /* FANN parameters: create */
 static const unsigned int NUM_LAYERS = 3; 
 static const unsigned int NUM_OUTPUT = 1; 
 
 /* FANN parameters: train */
-static const unsigned int EPOCHS_BETWEEN_REPORTS = 0; 
+/* data-parallel training: sessions per shard of the training set */
+static const unsigned int TRAINING_SHARD = 64;
+/* early stopping: a validation error must improve by this share to count */
+static const float PLATEAU_TOLERANCE = 0.01;
+/* and stops training at once beyond this many times the best one */
+static const float DIVERGENCE_RATIO = 2.0;
 
 /* strategy params */
 static const int MIN_COMMANDS = 4;	/* minimum number of commands */
@@ -27,6 +106,97 @@ static const int MIN_COMMANDS = 4;	/* minimum number of commands */
 //static const int TRAINING_SESSIONS = 10;
 //static const int TESTING_SESSIONS = 100;
 
-void evolve (char* datafile, int generations, unsigned int epochs, float error, int max_len, int starting_len, int training_sessions, int testing_sessions);
+/* error targets of a run, and when it first reached them */
+#define MAX_TARGETS 8
+struct target_t {
+	float error;
+	int reached;
+	double seconds;		/* wall time */
+	double cpu_seconds;	/* of the process, all threads */
+	unsigned long evaluations;
+};
+
+/* non-dominated strategies seen so far, in pareto mode */
+#define FRONT_SIZE 32
+struct front_t {
+	char *strategy;
+	struct fitness_t fitness;
+};
+
+/* 
+ * one run of the GA: its parameters and what came out of it.
+ * Runs are independent, several can go at once (see sweep.c)
+ */
+struct run_t {
+	/* parameters */
+	unsigned int seed;	/* the root of all keys, in deterministic mode */
+	size_t popsize;		/* max strategies evaluated */
+	int generations;
+	unsigned int max_epochs;
+	float desired_error;
+	int max_len;		/* strategy max length */
+	int starting_len;	/* strategy starting length */
+	int training_sessions;
+	int testing_sessions;
+	char *datafile;		/* where to write training data, NULL to train in memory */
+	int parallel;		/* may use the worker pool and the pipeline */
+	int verbose;		/* print every generation */
+	/* the run stops once an evaluation reached every target error */
+	struct target_t targets[MAX_TARGETS];
+	int num_targets;
+
+	/* results */
+	char *best;		/* the last winner, NULL if none */
+	struct fitness_t best_fitness;
+	struct topology_t best_topology;	/* with -N */
+	unsigned long evaluations;
+	unsigned long epochs;	/* training epochs, over all the evaluations */
+	unsigned long screened;	/* offspring the surrogate discarded */
+	double seconds;		/* wall time */
+	double cpu_seconds;
+
+	/* steps per testing session, over the whole run */
+	unsigned long histogram[HISTOGRAM_BINS];
+	struct front_t front[FRONT_SIZE];
+	int front_size;
+};
+
+/* a strategy of the population, under its canonical form */
+struct member_t {
+	struct fitness_t fitness;
+	int scored;	/* 'fitness' is known */
+	char key[];
+};
+
+/* 
+ * strategies already evaluated, keyed on their canonical form (see
+ * canonical_strategy()): equivalent strategies are one member
+ */
+struct population_t {
+	struct hsearch_data table;
+	struct member_t **members;	/* what the table points to, to be freed */
+	unsigned int size, max;
+};
+
+int create_population(struct population_t *p, size_t max);
+void destroy_population(struct population_t *p);
+
+struct eval_ctx_t;
+struct fitness_t eval(struct run_t *run, struct eval_ctx_t *ctx, char* strategy, 
+		unsigned long eval_id);
+float rank_value(struct fitness_t *fitness);
+
+struct lanes_t;
+void eval_lanes(struct run_t *run, struct eval_ctx_t **ctxs, struct lanes_t *lanes, 
+		char **strategies, unsigned long *eval_ids, int n, struct fitness_t *fitness);
+
+/* called as each candidate of a batch is scored */
+typedef void (*scored_fn)(void *arg, int candidate, struct fitness_t *fitness);
+
+int eval_batch(struct run_t *run, char **strategies, int n, unsigned long first_id, 
+		struct fitness_t *fitness, scored_fn done, void *arg);
+void destroy_batch_groups();
+int evolve(struct run_t *run);
+void free_run(struct run_t *run);
 
 #endif
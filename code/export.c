@@ -0,0 +1,454 @@
+#ifndef _EXPORT_C
+#define _EXPORT_C
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <ctype.h>
+
+#include "export.h"
+#include "context.h"
+
+/* how the exported network does against the float one */
+struct fixed_check_t {
+	int scenarios;
+	double max_diff, mean_diff;	/* between the two outputs */
+	double float_error, fixed_error;	/* mean error of each */
+};
+
+/* FANN's stepwise sigmoid: linear in between these points, 0 and 1 outside */
+static double stepwise_sigmoid(double t) {
+	static const double x[6] = { -2.64665293693542480469, -1.47221934795379638672,
+		-0.549306154251098632812, 0.549306154251098632812, 1.47221934795379638672,
+		2.64665293693542480469 };
+	static const double y[6] = { 0.00499999988824129104614, 0.0500000007450580596924,
+		0.25, 0.75, 0.949999988079071044922, 0.995000004768371582031 };
+	int k;
+
+	if ( t < x[0] )
+		return 0;
+	for ( k = 0 ; k < 5 ; k++ )
+		if ( t < x[k+1] )
+			return y[k] + (t - x[k]) * (y[k+1] - y[k]) / (x[k+1] - x[k]);
+	return 1;
+}
+
+/*
+ * the sigmoid (or Elliot function) of a layer, as a Q15 table; returns
+ * -1 if the layer has another activation, or several
+ */
+static int activation_table(int16_t *table, struct fann_layer *layer, float *steepness) {
+	struct fann_neuron *first = layer->first_neuron, *neuron;
+	double t, y;
+	int i, symmetric, elliot = 0, stepwise = 0;
+
+	/* the bias neuron has no activation */
+	for ( neuron = first ; neuron < layer->last_neuron - 1 ; neuron++ )
+		if ( neuron->activation_function != first->activation_function
+				|| neuron->activation_steepness != first->activation_steepness )
+			return -1;
+
+	switch ( first->activation_function ) {
+		case FANN_SIGMOID:
+			symmetric = 0;
+			break;
+		case FANN_SIGMOID_STEPWISE:
+			symmetric = 0;
+			stepwise = 1;
+			break;
+		case FANN_SIGMOID_SYMMETRIC:
+			symmetric = 1;
+			break;
+		case FANN_SIGMOID_SYMMETRIC_STEPWISE:
+			symmetric = 1;
+			stepwise = 1;
+			break;
+		case FANN_ELLIOT:
+			symmetric = 0;
+			elliot = 1;
+			break;
+		case FANN_ELLIOT_SYMMETRIC:
+			symmetric = 1;
+			elliot = 1;
+			break;
+		default:
+			return -1;
+	}
+
+	for ( i = 0 ; i < EXPORT_TABLE_SIZE ; i++ ) {
+		t = EXPORT_TABLE_RANGE * (2.0 * i / (EXPORT_TABLE_SIZE - 1) - 1);
+		/* as FANN, with the steepness folded into the weights */
+		if ( elliot )
+			y = t / 2 / (1 + fabs(t)) + 0.5;
+		else if ( stepwise )
+			y = stepwise_sigmoid(t);
+		else
+			y = 1 / (1 + exp(-2 * t));
+		if ( symmetric )
+			y = 2 * y - 1;
+		y = round(y * 32768);
+		table[i] = y > INT16_MAX ? INT16_MAX : y < INT16_MIN ? INT16_MIN : (int16_t)y;
+	}
+	*steepness = first->activation_steepness;
+	return 0;
+}
+
+/*
+ * the most fractional bits for the weights of a layer such that every
+ * weight fits in 16 bits, and a neuron's sum of 16-bit values weighed
+ * by them in 32 bits; -1 if there are none
+ */
+static int weight_frac(struct fann *ann, struct fann_layer *layer, float steepness) {
+	struct fann_neuron *neuron;
+	unsigned int c;
+	double q, sum;
+	int frac;
+
+	for ( frac = 15 ; frac >= 0 ; frac-- ) {
+		for ( neuron = layer->first_neuron ; neuron < layer->last_neuron - 1 ; neuron++ ) {
+			sum = 0;
+			for ( c = neuron->first_con ; c < neuron->last_con ; c++ ) {
+				q = fabs(round(ann->weights[c] * steepness * ldexp(1, frac)));
+				if ( q > INT16_MAX )
+					break;
+				sum += q;
+			}
+			/* |sum| <= 65535 * 32768 < 2^31 */
+			if ( c < neuron->last_con || sum > 65535 )
+				break;
+		}
+		if ( neuron == layer->last_neuron - 1 )
+			return frac;
+	}
+	return -1;
+}
+
+static void quantise_layer(int16_t *dest, struct fann *ann, struct fann_layer *layer,
+		float steepness, int frac) {
+	struct fann_neuron *neuron;
+	unsigned int c;
+
+	for ( neuron = layer->first_neuron ; neuron < layer->last_neuron - 1 ; neuron++ )
+		for ( c = neuron->first_con ; c < neuron->last_con ; c++ )
+			*dest++ = (int16_t)round(ann->weights[c] * steepness * ldexp(1, frac));
+}
+
+/* a standard 3 layer network, one output; returns -1 if it cannot be done */
+int quantise_network(struct fixed_net_t *q, struct fann *ann, int input_frac) {
+	struct fann_layer *hidden = ann->first_layer + 1, *output = ann->first_layer + 2;
+	float hidden_steepness, output_steepness;
+
+	memset(q, 0, sizeof(struct fixed_net_t));
+	if ( ann->last_layer - ann->first_layer != 3 || ann->num_output != 1 )
+		return -1;
+	q->inputs = ann->num_input;
+	q->hidden = hidden->last_neuron - hidden->first_neuron - 1;
+	q->input_frac = input_frac;
+
+	if ( activation_table(q->hidden_table, hidden, &hidden_steepness) < 0
+			|| activation_table(q->output_table, output, &output_steepness) < 0 )
+		return -1;
+	q->hidden_frac = weight_frac(ann, hidden, hidden_steepness);
+	q->output_frac = weight_frac(ann, output, output_steepness);
+	/* the activation takes sums with at least 8 fractional bits */
+	if ( q->hidden_frac < 0 || q->output_frac < 0 || q->hidden_frac + input_frac < 8 )
+		return -1;
+
+	q->hidden_weights = malloc(sizeof(int16_t) * q->hidden * (q->inputs + 1));
+	q->output_weights = malloc(sizeof(int16_t) * (q->hidden + 1));
+	if ( q->hidden_weights == NULL || q->output_weights == NULL ) {
+		free_fixed_net(q);
+		return -1;
+	}
+	quantise_layer(q->hidden_weights, ann, hidden, hidden_steepness, q->hidden_frac);
+	quantise_layer(q->output_weights, ann, output, output_steepness, q->output_frac);
+	return 0;
+}
+
+void free_fixed_net(struct fixed_net_t *q) {
+	free(q->hidden_weights);
+	free(q->output_weights);
+	q->hidden_weights = q->output_weights = NULL;
+}
+
+/*
+ * a sum with 'frac' fractional bits through a table, in Q15: the same
+ * as the generated activation()
+ */
+static int16_t fixed_activation(const int16_t *table, int32_t sum, int frac) {
+	/* 8 fractional bits, the table has a point every 16 */
+	int32_t t = sum >> (frac - 8);
+
+	if ( t < -2048 )
+		t = -2048;
+	if ( t > 2047 )
+		t = 2047;
+	t += 2048;
+	return table[t >> 4] + (((int32_t)(table[(t >> 4) + 1] - table[t >> 4]) * (t & 15)) >> 4);
+}
+
+/* the same as the generated <name>_run() */
+int16_t fixed_run(struct fixed_net_t *q, const int16_t *inputs) {
+	int16_t hidden[q->hidden];
+	const int16_t *w;
+	int32_t sum;
+	int h, i;
+
+	for ( h = 0 ; h < q->hidden ; h++ ) {
+		w = &q->hidden_weights[h * (q->inputs + 1)];
+		sum = (int32_t)w[q->inputs] * (1 << q->input_frac);
+		for ( i = 0 ; i < q->inputs ; i++ )
+			sum += (int32_t)w[i] * inputs[i];
+		hidden[h] = fixed_activation(q->hidden_table, sum, q->hidden_frac + q->input_frac);
+	}
+	sum = (int32_t)q->output_weights[q->hidden] * (1 << 15);
+	for ( h = 0 ; h < q->hidden ; h++ )
+		sum += (int32_t)q->output_weights[h] * hidden[h];
+	return fixed_activation(q->output_table, sum, q->output_frac + 15);
+}
+
+static int16_t fixed_input(fann_type x, int frac) {
+	double q = round(x * ldexp(1, frac));
+
+	return q > INT16_MAX ? INT16_MAX : q < INT16_MIN ? INT16_MIN : (int16_t)q;
+}
+
+/* the finest input format, with twice the inputs of the testing sessions to spare */
+static int input_frac(struct eval_ctx_t *ctx, int sessions) {
+	double max = 0;
+	int i, j, frac;
+
+	for ( i = 0 ; i < sessions ; i++ )
+		for ( j = 0 ; j < ctx->input_neurones ; j++ )
+			if ( fabs(ctx->testing_inputs[i][j]) > max )
+				max = fabs(ctx->testing_inputs[i][j]);
+	for ( frac = 14 ; frac > 0 && 2 * max * ldexp(1, frac) > INT16_MAX ; frac-- )
+		;
+	return frac;
+}
+
+/*
+ * zero the weights of the inputs no gene senses into: the strategy runs
+ * into every other slot of 3 inputs (see run_program_mem()), the others
+ * are 0 whatever the scenario. iRPROP- lets their weights grow to FANN's
+ * limit of 1500, where they weigh on nothing but would take all the bits
+ * of the layer. The network gives the same outputs without them.
+ */
+static void drop_idle_inputs(struct fann *ann) {
+	struct fann_layer *hidden = ann->first_layer + 1;
+	struct fann_neuron *neuron;
+	unsigned int j;
+
+	for ( j = 0 ; j < ann->num_input ; j++ ) {
+		if ( (j / 3) % 2 == 0 )
+			continue;
+		for ( neuron = hidden->first_neuron ; neuron < hidden->last_neuron - 1 ; neuron++ )
+			ann->weights[neuron->first_con + j] = 0;
+	}
+}
+
+/* both networks on the testing sessions of 'bank' */
+static void check_fixed(struct fann *ann, struct eval_ctx_t *bank, struct fixed_net_t *q,
+		int sessions, struct fixed_check_t *check) {
+	int16_t inputs[q->inputs];
+	double output, fixed, diff;
+	int i, j;
+
+	memset(check, 0, sizeof(struct fixed_check_t));
+	for ( i = 0 ; i < sessions ; i++ ) {
+		output = fann_run(ann, bank->testing_inputs[i])[0];
+		for ( j = 0 ; j < q->inputs ; j++ )
+			inputs[j] = fixed_input(bank->testing_inputs[i][j], q->input_frac);
+		fixed = fixed_run(q, inputs) / 32768.0;
+
+		diff = fabs(output - fixed);
+		if ( diff > check->max_diff )
+			check->max_diff = diff;
+		check->mean_diff += diff;
+		check->float_error += fabs(bank->testing_outputs[i] - output);
+		check->fixed_error += fabs(bank->testing_outputs[i] - fixed);
+	}
+	check->scenarios = sessions;
+	if ( sessions > 0 ) {
+		check->mean_diff /= sessions;
+		check->float_error /= sessions;
+		check->fixed_error /= sessions;
+	}
+}
+
+static void write_array(FILE *f, const int16_t *a, int n) {
+	int i;
+
+	for ( i = 0 ; i < n ; i++ )
+		fprintf(f, "%s%d,", i % 12 == 0 ? "\n\t\t" : " ", a[i]);
+}
+
+/* the header and source of the module; returns -1 on failure */
+static int write_module(char *prefix, struct fixed_net_t *q, char *strategy,
+		struct fixed_check_t *check) {
+	char filename[strlen(prefix) + 3], name[strlen(prefix) + 2], upper[strlen(prefix) + 2];
+	char *base = strrchr(prefix, '/') != NULL ? strrchr(prefix, '/') + 1 : prefix;
+	char canonical[strlen(strategy) + 1];
+	int i, genes;
+	FILE *f;
+
+	/* identifiers from the file name */
+	for ( i = 0 ; base[i] != '\0' ; i++ ) {
+		name[i] = isalnum((unsigned char)base[i]) ? base[i] : '_';
+		upper[i] = toupper((unsigned char)name[i]);
+	}
+	name[i] = upper[i] = '\0';
+	if ( i == 0 || isdigit((unsigned char)name[0]) ) {
+		fprintf(stderr, "Not a C identifier: %s\n", base);
+		return -1;
+	}
+
+	/* what the device runs: the genes the simulator executes */
+	canonical_strategy(canonical, strategy);
+	genes = (strlen(canonical) / 2 + 1) / 2;
+
+	sprintf(filename, "%s.h", prefix);
+	f = fopen(filename, "w");
+	if ( f == NULL ) {
+		perror("Unable to open the header for writing");
+		return -1;
+	}
+	fprintf(f, "/* %s.h: generated by sim -X, do not edit */\n", base);
+	fprintf(f, "#ifndef %s_H\n#define %s_H\n\n#include <stdint.h>\n\n", upper, upper);
+	fprintf(f, "/*\n * strategy ");
+	for ( i = 0 ; strategy[i] != '\0' ; i++ )
+		fprintf(f, "%d", strategy[i]);
+	fprintf(f, ": the genes the device runs, in order, as\n");
+	fprintf(f, " * { action, condition } (see scenario.h); gene i senses into inputs\n");
+	fprintf(f, " * 6i to 6i+2 (position, angle, status), the other inputs stay 0\n */\n");
+	fprintf(f, "#define %s_GENES %d\n", upper, genes);
+	fprintf(f, "extern const uint8_t %s_genes[%s_GENES][2];\n\n", name, upper);
+	fprintf(f, "/* the network: inputs with %s_INPUT_FRAC fractional bits, output in Q15 */\n", upper);
+	fprintf(f, "#define %s_INPUTS %d\n", upper, q->inputs);
+	fprintf(f, "#define %s_INPUT_FRAC %d\n", upper, q->input_frac);
+	fprintf(f, "int16_t %s_run(const int16_t *inputs);\n\n#endif\n", name);
+	if ( fclose(f) != 0 ) {
+		perror("Unable to write the header");
+		return -1;
+	}
+
+	sprintf(filename, "%s.c", prefix);
+	f = fopen(filename, "w");
+	if ( f == NULL ) {
+		perror("Unable to open the source for writing");
+		return -1;
+	}
+	fprintf(f, "/*\n * %s.c: generated by sim -X, do not edit\n", base);
+	fprintf(f, " * output within %f (mean %f) of the float network over %d scenarios\n */\n",
+			check->max_diff, check->mean_diff, check->scenarios);
+	fprintf(f, "#include \"%s.h\"\n\n", base);
+	fprintf(f, "#define HIDDEN %d\n#define HIDDEN_FRAC %d\n#define OUTPUT_FRAC %d\n\n",
+			q->hidden, q->hidden_frac, q->output_frac);
+
+	fprintf(f, "const uint8_t %s_genes[%s_GENES][2] = {\n", name, upper);
+	for ( i = 0 ; i < genes ; i++ )
+		fprintf(f, "\t{ %d, %d },\n", canonical[2*i], canonical[2*i+1]);
+	fprintf(f, "};\n\n");
+
+	/* the steepness is folded into the weights, the bias is last */
+	fprintf(f, "static const int16_t hidden_weights[HIDDEN][%s_INPUTS + 1] = {", upper);
+	for ( i = 0 ; i < q->hidden ; i++ ) {
+		fprintf(f, "\n\t{");
+		write_array(f, &q->hidden_weights[i * (q->inputs + 1)], q->inputs + 1);
+		fprintf(f, "\n\t},");
+	}
+	fprintf(f, "\n};\n\nstatic const int16_t output_weights[HIDDEN + 1] = {");
+	write_array(f, q->output_weights, q->hidden + 1);
+	fprintf(f, "\n};\n\n/* sigmoids in Q15, from -%d to %d */\n", EXPORT_TABLE_RANGE, EXPORT_TABLE_RANGE);
+	fprintf(f, "static const int16_t hidden_table[%d] = {", EXPORT_TABLE_SIZE);
+	write_array(f, q->hidden_table, EXPORT_TABLE_SIZE);
+	fprintf(f, "\n};\n\nstatic const int16_t output_table[%d] = {", EXPORT_TABLE_SIZE);
+	write_array(f, q->output_table, EXPORT_TABLE_SIZE);
+	fprintf(f, "\n};\n\n");
+
+	fprintf(f, "/* a sum with 'frac' fractional bits through a table, in Q15 */\n");
+	fprintf(f, "static int16_t activation(const int16_t *table, int32_t sum, int frac) {\n");
+	fprintf(f, "\t/* 8 fractional bits (an arithmetic shift), the table has a point every 16 */\n");
+	fprintf(f, "\tint32_t t = sum >> (frac - 8);\n\n");
+	fprintf(f, "\tif ( t < -2048 )\n\t\tt = -2048;\n\tif ( t > 2047 )\n\t\tt = 2047;\n\tt += 2048;\n");
+	fprintf(f, "\treturn table[t >> 4] + (((int32_t)(table[(t >> 4) + 1] - table[t >> 4]) * (t & 15)) >> 4);\n}\n\n");
+
+	fprintf(f, "int16_t %s_run(const int16_t *inputs) {\n", name);
+	fprintf(f, "\tint16_t hidden[HIDDEN];\n\tint32_t sum;\n\tint h, i;\n\n");
+	fprintf(f, "\tfor ( h = 0 ; h < HIDDEN ; h++ ) {\n");
+	fprintf(f, "\t\tsum = (int32_t)hidden_weights[h][%s_INPUTS] * (1 << %s_INPUT_FRAC);\n", upper, upper);
+	fprintf(f, "\t\tfor ( i = 0 ; i < %s_INPUTS ; i++ )\n", upper);
+	fprintf(f, "\t\t\tsum += (int32_t)hidden_weights[h][i] * inputs[i];\n");
+	fprintf(f, "\t\thidden[h] = activation(hidden_table, sum, HIDDEN_FRAC + %s_INPUT_FRAC);\n\t}\n", upper);
+	fprintf(f, "\tsum = (int32_t)output_weights[HIDDEN] * (1 << 15);\n");
+	fprintf(f, "\tfor ( h = 0 ; h < HIDDEN ; h++ )\n");
+	fprintf(f, "\t\tsum += (int32_t)output_weights[h] * hidden[h];\n");
+	fprintf(f, "\treturn activation(output_table, sum, OUTPUT_FRAC + 15);\n}\n");
+	if ( fclose(f) != 0 ) {
+		perror("Unable to write the source");
+		return -1;
+	}
+	return 0;
+}
+
+/* train the champion again, save its network and the module */
+int export_champion(struct run_t *run, char *prefix) {
+	struct eval_ctx_t *ctx, *bank = NULL;
+	struct fixed_net_t q;
+	struct fixed_check_t check;
+	char filename[strlen(prefix) + 5];
+	int ret = -1;
+
+	if ( run->best == NULL ) {
+		fprintf(stderr, "No champion to export\n");
+		return -1;
+	}
+	ctx = create_context();
+	if ( ctx == NULL )
+		return -1;
+	memset(&q, 0, sizeof(q));
+
+	/* a new evaluation: its testing sessions set the input format */
+	ctx->topology = OPTIONS.topology ? &run->best_topology : NULL;
+	eval(run, ctx, run->best, run->evaluations);
+	if ( ctx->ann == NULL ) {
+		fprintf(stderr, "Unable to train the champion\n");
+		goto out;
+	}
+	/* the .net is the network of the module */
+	drop_idle_inputs(ctx->ann);
+	sprintf(filename, "%s.net", prefix);
+	if ( fann_save(ctx->ann, filename) != 0 ) {
+		fprintf(stderr, "Unable to save %s\n", filename);
+		goto out;
+	}
+
+	if ( quantise_network(&q, ctx->ann, input_frac(ctx, run->testing_sessions)) < 0 ) {
+		fprintf(stderr, "Unable to quantise the network of the champion\n");
+		goto out;
+	}
+
+	/* checked on scenarios of its own: the testing sessions of the next evaluation */
+	bank = create_context();
+	if ( bank == NULL )
+		goto out;
+	eval(run, bank, run->best, run->evaluations + 1);
+	if ( bank->ann == NULL ) {
+		fprintf(stderr, "Unable to simulate the champion\n");
+		goto out;
+	}
+	check_fixed(ctx->ann, bank, &q, run->testing_sessions, &check);
+	if ( write_module(prefix, &q, run->best, &check) < 0 )
+		goto out;
+
+	printf("Exported %s.net, %s.h, %s.c: output within %f (mean %f) of the float network, "
+			"error %f (float %f) over %d scenarios\n", prefix, prefix, prefix,
+			check.max_diff, check.mean_diff, check.fixed_error, check.float_error, check.scenarios);
+	ret = 0;
+out:
+	free_fixed_net(&q);
+	destroy_context(bank);
+	destroy_context(ctx);
+	return ret;
+}
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef _EXPORT_H
+#define _EXPORT_H
+
+#include <stdint.h>
+
+#include "evolution.h"
+
+/*
+ * export of a run's champion to the device: its network is trained
+ * again and saved with fann_save() into <prefix>.net, and a C module
+ * <prefix>.h, <prefix>.c is generated with the genes the strategy runs
+ * and a fixed-point copy of the network. The module needs no library
+ * and allocates nothing:
+ *
+ *   int16_t <name>_run(const int16_t *inputs);
+ *
+ * takes the sensed conditions with <NAME>_INPUT_FRAC fractional bits
+ * and returns the network output in Q15 (1.0 is 32768).
+ *
+ * Weights are int16, with the activation steepness folded in; each
+ * layer has the finest format in which no sum can overflow 32 bits,
+ * whatever the inputs. Sigmoids are tables of EXPORT_TABLE_SIZE points
+ * over [-EXPORT_TABLE_RANGE, EXPORT_TABLE_RANGE], interpolated, of the
+ * stepwise sigmoid for networks trained with it, as FANN runs them. So are
+ * Elliot functions (-N), which saturate slowly: past the table they are
+ * off by up to 1 / (2 * (1 + EXPORT_TABLE_RANGE)).
+ *
+ * Inputs no gene senses into are always 0: their weights are zeroed
+ * before the network is saved, so the .net and the module agree.
+ * The input format is set from the testing scenarios of the new
+ * evaluation; the fixed-point network is checked against the float one
+ * on scenarios drawn anew (from the corpus with -K).
+ */
+#define EXPORT_TABLE_SIZE 257
+#define EXPORT_TABLE_RANGE 8
+
+struct fixed_net_t {
+	int inputs, hidden;
+	int input_frac;		/* fractional bits of the inputs */
+	int hidden_frac;	/* of the hidden layer's weights */
+	int output_frac;	/* of the output's weights */
+	int16_t *hidden_weights;	/* inputs + 1 per hidden neuron, bias last */
+	int16_t *output_weights;	/* hidden + 1, bias last */
+	int16_t hidden_table[EXPORT_TABLE_SIZE];
+	int16_t output_table[EXPORT_TABLE_SIZE];
+};
+
+int quantise_network(struct fixed_net_t *q, struct fann *ann, int input_frac);
+void free_fixed_net(struct fixed_net_t *q);
+int16_t fixed_run(struct fixed_net_t *q, const int16_t *inputs);
+int export_champion(struct run_t *run, char *prefix);
+
+#endif
@@ -0,0 +1,328 @@
+#ifndef _LANES_C
+#define _LANES_C
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "lanes.h"
+
+/* FANN's stepwise sigmoid: linear in between these points, 0 and 1 outside */
+static const float STEPWISE_X[6] = { -2.64665293693542480469, -1.47221934795379638672,
+	-0.549306154251098632812, 0.549306154251098632812, 1.47221934795379638672,
+	2.64665293693542480469 };
+static const float STEPWISE_Y[6] = { 0.00499999988824129104614, 0.0500000007450580596924,
+	0.25, 0.75, 0.949999988079071044922, 0.995000004768371582031 };
+
+/* FANN caps the steepened sums of a neuron */
+static const float MAX_SUM = 150;
+
+static inline lane_t lane_set(float x) {
+	lane_t v = { 0 };
+	return v + x;
+}
+
+/* lane by lane, a where m is set, b elsewhere */
+static inline lane_t lane_select(lane_mask_t m, lane_t a, lane_t b) {
+	return (lane_t)(((lane_mask_t)a & m) | ((lane_mask_t)b & ~m));
+}
+
+static inline lane_t lane_min(lane_t a, lane_t b) {
+	return lane_select(a < b, a, b);
+}
+
+static inline lane_t lane_max(lane_t a, lane_t b) {
+	return lane_select(a > b, a, b);
+}
+
+static inline lane_t lane_abs(lane_t a) {
+	return (lane_t)((lane_mask_t)a & 0x7fffffff);
+}
+
+/* the activation of a steepened sum */
+static inline lane_t activate(int activation, lane_t sum) {
+	lane_t value;
+	int k;
+
+	if ( activation == FANN_ELLIOT )
+		return sum / 2.0f / (1.0f + lane_abs(sum)) + 0.5f;
+
+	value = lane_set(0);
+	for ( k = 0 ; k < 5 ; k++ )
+		value = lane_select(sum >= STEPWISE_X[k], STEPWISE_Y[k] + (sum - STEPWISE_X[k])
+				* ((STEPWISE_Y[k+1] - STEPWISE_Y[k]) / (STEPWISE_X[k+1] - STEPWISE_X[k])), value);
+	return lane_select(sum >= STEPWISE_X[5], lane_set(1), value);
+}
+
+/* its derivative, as fann_activation_derived() */
+static inline lane_t derive(int activation, float steepness, lane_t sum, lane_t value) {
+	lane_t d;
+
+	if ( activation == FANN_ELLIOT ) {
+		d = 1.0f + lane_abs(sum);
+		return steepness / (2.0f * d * d);
+	}
+	value = lane_min(lane_max(value, lane_set(0.01)), lane_set(0.99));
+	return 2.0f * steepness * value * (1.0f - value);
+}
+
+/* the sum of a neuron, steepened and capped */
+static inline lane_t steepen(lane_t sum, float steepness) {
+	sum *= steepness;
+	return lane_min(lane_max(sum, lane_set(-MAX_SUM / steepness)), lane_set(MAX_SUM / steepness));
+}
+
+/* FANN_ERRORFUNC_TANH, FANN's default: large differences weigh more */
+static inline lane_t tanh_error(lane_t diff) {
+	int k;
+
+	for ( k = 0 ; k < LANES ; k++ ) {
+		if ( diff[k] < -.9999999 )
+			diff[k] = -17;
+		else if ( diff[k] > .9999999 )
+			diff[k] = 17;
+		else
+			diff[k] = (float)log((1.0 + diff[k]) / (1.0 - diff[k]));
+	}
+	return diff;
+}
+
+/* grow an aligned buffer to at least 'need' elements; its contents are lost */
+static int grow_lanes(void **buf, unsigned int *max, unsigned int need, size_t size) {
+	void *p;
+
+	if ( need <= *max )
+		return 0;
+	if ( posix_memalign(&p, sizeof(lane_t), need * size) != 0 )
+		return -1;
+	free(*buf);
+	*buf = p;
+	*max = need;
+	return 0;
+}
+
+void free_lanes(struct lanes_t *l) {
+	free(l->weights);
+	free(l->data);
+	free(l->desired);
+	free(l->sums);
+	memset(l, 0, sizeof(struct lanes_t));
+}
+
+/* the activation and steepness of a layer; -1 if the lanes have no such layer */
+static int layer_activation(struct fann_layer *layer, int *activation, float *steepness) {
+	struct fann_neuron *first = layer->first_neuron, *neuron;
+
+	/* the bias neuron has no activation */
+	for ( neuron = first ; neuron < layer->last_neuron - 1 ; neuron++ )
+		if ( neuron->activation_function != first->activation_function
+				|| neuron->activation_steepness != first->activation_steepness )
+			return -1;
+	if ( first->activation_function != FANN_SIGMOID_STEPWISE
+			&& first->activation_function != FANN_ELLIOT )
+		return -1;
+	*activation = first->activation_function;
+	*steepness = first->activation_steepness;
+	return 0;
+}
+
+/* can network 'ann' join the lanes of the first? Sets its widths. */
+static int fits(struct lanes_t *l, struct fann *ann, struct fann_train_data *data, int first,
+		unsigned int *inputs, unsigned int *hidden) {
+	int hidden_activation, output_activation;
+	float hidden_steepness, output_steepness;
+
+	if ( ann->last_layer - ann->first_layer != 3 || ann->num_output != 1
+			|| data->num_input != ann->num_input || data->num_output != 1
+			|| layer_activation(&ann->first_layer[1], &hidden_activation, &hidden_steepness) < 0
+			|| layer_activation(&ann->first_layer[2], &output_activation, &output_steepness) < 0 )
+		return -1;
+	if ( first ) {
+		l->hidden_activation = hidden_activation;
+		l->hidden_steepness = hidden_steepness;
+		l->output_activation = output_activation;
+		l->output_steepness = output_steepness;
+		l->sessions = data->num_data;
+	} else if ( hidden_activation != l->hidden_activation || hidden_steepness != l->hidden_steepness
+			|| output_activation != l->output_activation || output_steepness != l->output_steepness
+			|| data->num_data != l->sessions ) {
+		return -1;
+	}
+	*inputs = ann->num_input;
+	*hidden = ann->first_layer[1].last_neuron - ann->first_layer[1].first_neuron - 1;
+	return 0;
+}
+
+/* where the padded network has connection 'c' of a network of these widths */
+static unsigned int padded(struct lanes_t *l, unsigned int inputs, unsigned int hidden,
+		unsigned int c) {
+	unsigned int stride = l->inputs + 1;
+
+	if ( c >= hidden * (inputs + 1) ) {
+		/* the output neuron's, bias last */
+		c -= hidden * (inputs + 1);
+		return l->hidden * stride + (c == hidden ? l->hidden : c);
+	}
+	/* hidden neuron c / (inputs + 1)'s, bias last */
+	return c / (inputs + 1) * stride + (c % (inputs + 1) == inputs ? l->inputs : c % (inputs + 1));
+}
+
+/* one epoch of all the lanes: accumulates the slopes, returns the summed squared errors */
+static lane_t lanes_epoch(struct lanes_t *l) {
+	const unsigned int inputs = l->inputs, hidden = l->hidden, stride = inputs + 1;
+	lane_t *output_weights = &l->weights[hidden * stride];
+	lane_t *output_slopes = &l->slopes[hidden * stride];
+	lane_t mse = lane_set(0), sum, output, diff, error, hidden_error, *x, *w, *g;
+	unsigned int s, h, j;
+
+	for ( s = 0 ; s < l->sessions ; s++ ) {
+		x = &l->data[s * inputs];
+
+		/* forward */
+		for ( h = 0 ; h < hidden ; h++ ) {
+			w = &l->weights[h * stride];
+			sum = lane_set(0);
+			for ( j = 0 ; j < inputs ; j++ )
+				sum += w[j] * x[j];
+			sum += w[inputs];
+			l->sums[h] = steepen(sum, l->hidden_steepness);
+			l->values[h] = activate(l->hidden_activation, l->sums[h]);
+		}
+		sum = lane_set(0);
+		for ( h = 0 ; h < hidden ; h++ )
+			sum += output_weights[h] * l->values[h];
+		sum += output_weights[hidden];
+		sum = steepen(sum, l->output_steepness);
+		output = activate(l->output_activation, sum);
+
+		/* the error, as fann_compute_MSE() */
+		diff = l->desired[s] - output;
+		mse += diff * diff;
+		error = derive(l->output_activation, l->output_steepness, sum, output) * tanh_error(diff);
+
+		/* backward, as fann_backpropagate_MSE() and fann_update_slopes_batch() */
+		for ( h = 0 ; h < hidden ; h++ ) {
+			hidden_error = error * output_weights[h]
+				* derive(l->hidden_activation, l->hidden_steepness, l->sums[h], l->values[h]);
+			output_slopes[h] += error * l->values[h];
+			g = &l->slopes[h * stride];
+			for ( j = 0 ; j < inputs ; j++ )
+				g[j] += hidden_error * x[j];
+			g[inputs] += hidden_error;
+		}
+		output_slopes[hidden] += error;
+	}
+
+	return mse;
+}
+
+/* iRPROP-, as fann_update_weights_irpropm(), on the connections of the 'active' lanes */
+static void lanes_update(struct lanes_t *l, lane_mask_t active) {
+	lane_t slope, step, prev_step, weight;
+	lane_mask_t m, same_sign;
+	unsigned int c;
+
+	for ( c = 0 ; c < l->connections ; c++ ) {
+		m = l->mask[c] & active;
+		slope = l->slopes[c];
+		prev_step = lane_max(l->steps[c], lane_set(0.0001));
+		same_sign = l->prev_slopes[c] * slope >= 0.0f;
+
+		step = lane_select(same_sign, lane_min(prev_step * RPROP_INCREASE, lane_set(RPROP_DELTA_MAX)),
+				lane_max(prev_step * RPROP_DECREASE, lane_set(RPROP_DELTA_MIN)));
+		slope = lane_select(same_sign, slope, lane_set(0));
+		weight = lane_select(slope < 0.0f, lane_max(l->weights[c] - step, lane_set(-1500)),
+				lane_min(l->weights[c] + step, lane_set(1500)));
+
+		l->weights[c] = lane_select(m, weight, l->weights[c]);
+		l->steps[c] = lane_select(m, step, l->steps[c]);
+		l->prev_slopes[c] = lane_select(m, slope, l->prev_slopes[c]);
+		l->slopes[c] = lane_set(0);
+	}
+}
+
+/*
+ * train networks anns[0..n-1], n <= LANES, each on its own training set,
+ * from their current weights: the trained weights are written back, and
+ * the epochs of every network into 'epochs'. Returns -1 (nothing
+ * trained) if the networks cannot share lanes or out of memory.
+ */
+int train_lanes(struct lanes_t *l, struct fann **anns, struct fann_train_data **data, int n,
+		unsigned int max_epochs, float desired_error, unsigned int *epochs) {
+	unsigned int inputs[LANES], hidden[LANES], s, j, c, p, epoch;
+	lane_mask_t active = { 0 };
+	lane_t mse;
+	int k;
+
+	if ( n < 1 || n > LANES )
+		return -1;
+	l->inputs = l->hidden = 0;
+	for ( k = 0 ; k < n ; k++ ) {
+		if ( fits(l, anns[k], data[k], k == 0, &inputs[k], &hidden[k]) < 0 )
+			return -1;
+		if ( inputs[k] > l->inputs )
+			l->inputs = inputs[k];
+		if ( hidden[k] > l->hidden )
+			l->hidden = hidden[k];
+	}
+	l->connections = l->hidden * (l->inputs + 1) + l->hidden + 1;
+	/* one block for the connections, one for the hidden neurons */
+	if ( grow_lanes((void**)&l->weights, &l->max_connections, 5 * l->connections, sizeof(lane_t)) < 0
+			|| grow_lanes((void**)&l->sums, &l->max_hidden, 2 * l->hidden, sizeof(lane_t)) < 0
+			|| grow_lanes((void**)&l->data, &l->max_data, l->sessions * l->inputs, sizeof(lane_t)) < 0
+			|| grow_lanes((void**)&l->desired, &l->max_sessions, l->sessions, sizeof(lane_t)) < 0 )
+		return -1;
+	l->slopes = l->weights + l->connections;
+	l->prev_slopes = l->slopes + l->connections;
+	l->steps = l->prev_slopes + l->connections;
+	l->mask = (lane_mask_t *)(l->steps + l->connections);
+	l->values = l->sums + l->hidden;
+
+	/* lay the networks and their training sets out, padded with zeros */
+	memset(l->weights, 0, sizeof(lane_t) * l->connections);
+	memset(l->slopes, 0, sizeof(lane_t) * l->connections);
+	memset(l->prev_slopes, 0, sizeof(lane_t) * l->connections);
+	memset(l->mask, 0, sizeof(lane_mask_t) * l->connections);
+	memset(l->data, 0, sizeof(lane_t) * l->sessions * l->inputs);
+	memset(l->desired, 0, sizeof(lane_t) * l->sessions);
+	for ( c = 0 ; c < l->connections ; c++ )
+		l->steps[c] = lane_set(RPROP_DELTA_ZERO);
+	for ( k = 0 ; k < n ; k++ ) {
+		for ( c = 0 ; c < anns[k]->total_connections ; c++ ) {
+			p = padded(l, inputs[k], hidden[k], c);
+			l->weights[p][k] = anns[k]->weights[c];
+			l->mask[p][k] = -1;
+		}
+		for ( s = 0 ; s < l->sessions ; s++ ) {
+			for ( j = 0 ; j < inputs[k] ; j++ )
+				l->data[s * l->inputs + j][k] = data[k]->input[s][j];
+			l->desired[s][k] = data[k]->output[s][0];
+		}
+		active[k] = -1;
+		epochs[k] = max_epochs;
+	}
+
+	/* as train_epochs(), a lane stops at its own desired error */
+	for ( epoch = 1 ; epoch <= max_epochs ; epoch++ ) {
+		mse = lanes_epoch(l);
+		lanes_update(l, active);
+		for ( k = 0 ; k < n ; k++ ) {
+			if ( active[k] != 0 && mse[k] / l->sessions <= desired_error ) {
+				epochs[k] = epoch;
+				active[k] = 0;
+			}
+		}
+		for ( k = 0 ; k < n && active[k] == 0 ; k++ )
+			;
+		if ( k == n )
+			break;
+	}
+
+	for ( k = 0 ; k < n ; k++ )
+		for ( c = 0 ; c < anns[k]->total_connections ; c++ )
+			anns[k]->weights[c] = l->weights[padded(l, inputs[k], hidden[k], c)][k];
+
+	return 0;
+}
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef _LANES_H
+#define _LANES_H
+
+#include <stdint.h>
+
+#include "floatfann.h"
+
+/*
+ * lane-batched training (-L): up to LANES networks of 3 layers and one
+ * output, each with its own training set, trained in lockstep. Lane l
+ * of every vector belongs to network l, so that the tiny products of
+ * one network (a few dozen inputs and hidden neurons) become products
+ * of LANES networks at once.
+ *
+ * The networks are padded to the widest inputs and hidden layer among
+ * them: padded inputs are 0, and padded connections are masked out of
+ * the updates so their weights stay 0. A network trains the same
+ * whichever networks share its lanes.
+ *
+ * Training is fann_train_epoch() with RPROP (iRPROP-, the tanh error
+ * function, FANN's default parameters) on the fixed schedule of
+ * train_epochs(): a network stops when its error is down to the desired
+ * error, and its lane idles until the others are done too. It is the
+ * same algorithm as FANN, not bit for bit the same sums.
+ *
+ * The networks of a batch must share their training set size and their
+ * activations (stepwise sigmoid or Elliot) and steepness per layer.
+ * With early stopping (-V) or sharded training (-T) the networks are
+ * trained one by one instead. The GA makes one offspring at a time: only
+ * its first pair is a batch, in deterministic mode (see evolve()).
+ */
+#ifdef __AVX__
+#define LANES 8
+#else
+/* as wide as SSE: build with -mavx (or -march=native) for 8 */
+#define LANES 4
+#endif
+
+typedef float lane_t __attribute__ ((vector_size (LANES * sizeof(float))));
+typedef int32_t lane_mask_t __attribute__ ((vector_size (LANES * sizeof(int32_t))));
+
+/* FANN's defaults for iRPROP- */
+static const float RPROP_INCREASE = 1.2;
+static const float RPROP_DECREASE = 0.5;
+static const float RPROP_DELTA_MIN = 0.0;
+static const float RPROP_DELTA_MAX = 50.0;
+static const float RPROP_DELTA_ZERO = 0.1;
+
+/* scratch for a batch, kept from one batch to the next */
+struct lanes_t {
+	unsigned int inputs, hidden;	/* the widest, without the biases */
+	unsigned int connections;	/* of the padded network */
+	unsigned int sessions;
+	int hidden_activation, output_activation;
+	float hidden_steepness, output_steepness;
+
+	/* per connection, bias last for every neuron */
+	lane_t *weights, *slopes, *prev_slopes, *steps;
+	lane_mask_t *mask;	/* lanes whose network has the connection */
+	unsigned int max_connections;
+
+	/* the training sets, interleaved: a row of inputs per session */
+	lane_t *data;
+	lane_t *desired;
+	unsigned int max_data, max_sessions;
+
+	/* one session, per hidden neuron */
+	lane_t *sums, *values;
+	unsigned int max_hidden;
+};
+
+void free_lanes(struct lanes_t *l);
+int train_lanes(struct lanes_t *l, struct fann **anns, struct fann_train_data **data, int n,
+		unsigned int max_epochs, float desired_error, unsigned int *epochs);
+
+#endif
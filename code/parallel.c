@@ -0,0 +1,139 @@
+#ifndef _PARALLEL_C
+#define _PARALLEL_C
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+
+#include "parallel.h"
+
+static pthread_t *workers = NULL;
+static int num_workers = 1;
+
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t job_start = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t job_done = PTHREAD_COND_INITIALIZER;
+/* only one loop at a time uses the pool */
+static pthread_mutex_t job_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* current job */
+static par_fn job_fn;
+static void *job_arg;
+static int job_items;
+static int next_item;
+static int busy;
+static unsigned long job_serial = 0;
+static int quit = 0;
+
+static void run_items(int worker) {
+	int i;
+	while ( (i = __sync_fetch_and_add(&next_item, 1)) < job_items )
+		job_fn(job_arg, i, worker);
+}
+
+static void *worker_main(void *p) {
+	int worker = (int)(long)p;
+	unsigned long seen = 0;
+
+	pthread_mutex_lock(&pool_lock);
+	while ( 1 ) {
+		while ( job_serial == seen && quit == 0 )
+			pthread_cond_wait(&job_start, &pool_lock);
+		if ( quit )
+			break;
+		seen = job_serial;
+		pthread_mutex_unlock(&pool_lock);
+
+		run_items(worker);
+
+		pthread_mutex_lock(&pool_lock);
+		if ( --busy == 0 )
+			pthread_cond_signal(&job_done);
+	}
+	pthread_mutex_unlock(&pool_lock);
+
+	return NULL;
+}
+
+/* start the pool; returns 0 on success */
+int par_init(int threads) {
+	int i;
+
+	par_destroy();
+	if ( threads < 1 )
+		threads = 1;
+
+	workers = malloc(sizeof(pthread_t) * threads);
+	if ( workers == NULL ) {
+		perror("Unable to allocate worker threads");
+		return -1;
+	}
+	quit = 0;
+	num_workers = 1;
+	/* worker 0 is the calling thread */
+	for ( i = 1 ; i < threads ; i++ ) {
+		if ( pthread_create(&workers[i], NULL, worker_main, (void*)(long)i) != 0 ) {
+			perror("Unable to start worker thread");
+			par_destroy();
+			return -1;
+		}
+		num_workers++;
+	}
+
+	return 0;
+}
+
+void par_destroy() {
+	int i;
+
+	if ( workers == NULL )
+		return;
+
+	pthread_mutex_lock(&pool_lock);
+	quit = 1;
+	pthread_cond_broadcast(&job_start);
+	pthread_mutex_unlock(&pool_lock);
+
+	for ( i = 1 ; i < num_workers ; i++ )
+		pthread_join(workers[i], NULL);
+
+	free(workers);
+	workers = NULL;
+	num_workers = 1;
+}
+
+int par_workers() {
+	return num_workers;
+}
+
+void par_for(int items, par_fn fn, void *arg) {
+	int i;
+
+	/* single thread, trivial loop, or pool already taken: run inline */
+	if ( num_workers == 1 || items < 2 || pthread_mutex_trylock(&job_lock) != 0 ) {
+		for ( i = 0 ; i < items ; i++ )
+			fn(arg, i, 0);
+		return;
+	}
+
+	pthread_mutex_lock(&pool_lock);
+	job_fn = fn;
+	job_arg = arg;
+	job_items = items;
+	next_item = 0;
+	busy = num_workers - 1;
+	job_serial++;
+	pthread_cond_broadcast(&job_start);
+	pthread_mutex_unlock(&pool_lock);
+
+	run_items(0);
+
+	pthread_mutex_lock(&pool_lock);
+	while ( busy > 0 )
+		pthread_cond_wait(&job_done, &pool_lock);
+	pthread_mutex_unlock(&pool_lock);
+
+	pthread_mutex_unlock(&job_lock);
+}
+
+#endif
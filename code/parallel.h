@@ -0,0 +1,23 @@
+#ifndef _PARALLEL_H
+#define _PARALLEL_H
+
+/*
+ * minimal pool of worker threads.
+ *
+ * par_for() runs fn(arg, item, worker) for every item in [0, items);
+ * items are handed out dynamically, so the body must not depend on the
+ * order of execution: results go into a slot indexed by 'item', and any
+ * reduction is done by the caller, in item order, afterwards.
+ * 'worker' is in [0, par_workers()) and can index per-thread scratch.
+ *
+ * The calling thread takes part as worker 0. A par_for() issued while
+ * another one is running (e.g. from inside a body) runs inline.
+ */
+typedef void (*par_fn)(void *arg, int item, int worker);
+
+int par_init(int threads);
+void par_destroy();
+int par_workers();
+void par_for(int items, par_fn fn, void *arg);
+
+#endif
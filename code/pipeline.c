@@ -0,0 +1,207 @@
+#ifndef _PIPELINE_C
+#define _PIPELINE_C
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "pipeline.h"
+#include "queue.h"
+
+/* an item on its way from a producer to a consumer */
+struct slot_t {
+	int item;
+	void *product;
+};
+
+static pthread_t *stage_threads = NULL;
+static int num_producers = 0, num_consumers = 0;
+static struct queue_t *ready = NULL;
+
+static pthread_mutex_t pipe_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t batch_start = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t batch_done = PTHREAD_COND_INITIALIZER;
+/* one batch at a time */
+static pthread_mutex_t run_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* current batch */
+static produce_fn batch_produce;
+static consume_fn batch_consume;
+static void *batch_arg;
+static struct slot_t *slots;
+static int batch_items;
+static int next_produced;		/* next item to produce */
+static int popped;		/* items taken by the consumers */
+static int running;		/* threads still working on the batch */
+static unsigned long batch_serial = 0;
+static int stopping = 0;
+
+static void produce_items(int thread) {
+	int i;
+
+	while ( (i = __sync_fetch_and_add(&next_produced, 1)) < batch_items ) {
+		slots[i].item = i;
+		slots[i].product = batch_produce(batch_arg, i, thread);
+		/* back-pressure: wait for the consumers to catch up */
+		while ( queue_push(ready, &slots[i]) < 0 )
+			sched_yield();
+	}
+}
+
+static void consume_items(int thread) {
+	struct slot_t *slot;
+
+	while ( __atomic_load_n(&popped, __ATOMIC_ACQUIRE) < batch_items ) {
+		slot = queue_pop(ready);
+		if ( slot == NULL ) {
+			/* the producers are late */
+			sched_yield();
+			continue;
+		}
+		__sync_fetch_and_add(&popped, 1);
+		batch_consume(batch_arg, slot->item, slot->product, thread);
+	}
+}
+
+static void *pipe_main(void *p) {
+	int thread = (int)(long)p;
+	unsigned long seen = 0;
+
+	pthread_mutex_lock(&pipe_lock);
+	while ( 1 ) {
+		while ( batch_serial == seen && stopping == 0 )
+			pthread_cond_wait(&batch_start, &pipe_lock);
+		if ( stopping )
+			break;
+		seen = batch_serial;
+		pthread_mutex_unlock(&pipe_lock);
+
+		if ( thread < num_producers )
+			produce_items(thread);
+		else
+			consume_items(thread);
+
+		pthread_mutex_lock(&pipe_lock);
+		if ( --running == 0 )
+			pthread_cond_signal(&batch_done);
+	}
+	pthread_mutex_unlock(&pipe_lock);
+
+	return NULL;
+}
+
+/* start the pipeline threads; returns 0 on success */
+int pipe_init(int producers, int consumers, int depth) {
+	int i;
+
+	pipe_destroy();
+	if ( producers < 1 )
+		producers = 1;
+	if ( consumers < 1 )
+		consumers = 1;
+	if ( depth < 1 )
+		depth = 1;
+
+	ready = queue_create(depth);
+	stage_threads = malloc(sizeof(pthread_t) * (producers + consumers));
+	if ( ready == NULL || stage_threads == NULL ) {
+		perror("Unable to allocate pipeline");
+		queue_destroy(ready);
+		free(stage_threads);
+		ready = NULL;
+		stage_threads = NULL;
+		return -1;
+	}
+
+	stopping = 0;
+	num_producers = producers;
+	num_consumers = consumers;
+	for ( i = 0 ; i < producers + consumers ; i++ ) {
+		if ( pthread_create(&stage_threads[i], NULL, pipe_main, (void*)(long)i) != 0 ) {
+			perror("Unable to start pipeline thread");
+			/* only join what was started */
+			num_producers = i < producers ? i : producers;
+			num_consumers = i - num_producers;
+			pipe_destroy();
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+void pipe_destroy() {
+	int i;
+
+	if ( stage_threads == NULL )
+		return;
+
+	pthread_mutex_lock(&pipe_lock);
+	stopping = 1;
+	pthread_cond_broadcast(&batch_start);
+	pthread_mutex_unlock(&pipe_lock);
+
+	for ( i = 0 ; i < num_producers + num_consumers ; i++ )
+		pthread_join(stage_threads[i], NULL);
+
+	free(stage_threads);
+	queue_destroy(ready);
+	stage_threads = NULL;
+	ready = NULL;
+	num_producers = 0;
+	num_consumers = 0;
+}
+
+int pipe_threads() {
+	return num_producers + num_consumers;
+}
+
+/* products that can wait between the stages */
+int pipe_depth() {
+	return ready != NULL ? (int)(ready->mask + 1) : 0;
+}
+
+/*
+ * run a batch through the pipeline, return when every item is consumed;
+ * without pipeline threads the stages run one after the other, here
+ */
+void pipe_run(int items, produce_fn produce, consume_fn consume, void *arg) {
+	int i;
+
+	if ( items <= 0 )
+		return;
+
+	pthread_mutex_lock(&run_lock);
+
+	if ( stage_threads != NULL )
+		slots = malloc(sizeof(struct slot_t) * items);
+	if ( stage_threads == NULL || slots == NULL ) {
+		for ( i = 0 ; i < items ; i++ )
+			consume(arg, i, produce(arg, i, 0), 0);
+		pthread_mutex_unlock(&run_lock);
+		return;
+	}
+
+	pthread_mutex_lock(&pipe_lock);
+	batch_produce = produce;
+	batch_consume = consume;
+	batch_arg = arg;
+	batch_items = items;
+	next_produced = 0;
+	popped = 0;
+	running = num_producers + num_consumers;
+	batch_serial++;
+	pthread_cond_broadcast(&batch_start);
+
+	while ( running > 0 )
+		pthread_cond_wait(&batch_done, &pipe_lock);
+	pthread_mutex_unlock(&pipe_lock);
+
+	free(slots);
+	slots = NULL;
+
+	pthread_mutex_unlock(&run_lock);
+}
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef _PIPELINE_H
+#define _PIPELINE_H
+
+/*
+ * two-stage pipeline over a batch of items.
+ *
+ * Producer threads run the cheap stage, produce(arg, item, thread), and
+ * hand its product to consumer threads running the expensive stage,
+ * consume(arg, item, product, thread), through a bounded lock-free
+ * queue. When the queue is full the producers wait (back-pressure), so
+ * at most pipe_depth() products wait between the stages.
+ *
+ * 'thread' is unique across the pipeline, in [0, pipe_threads()):
+ * producers come first, then consumers.
+ */
+typedef void *(*produce_fn)(void *arg, int item, int thread);
+typedef void (*consume_fn)(void *arg, int item, void *product, int thread);
+
+int pipe_init(int producers, int consumers, int depth);
+void pipe_destroy();
+int pipe_threads();
+int pipe_depth();
+void pipe_run(int items, produce_fn produce, consume_fn consume, void *arg);
+
+#endif
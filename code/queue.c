@@ -0,0 +1,105 @@
+#ifndef _QUEUE_C
+#define _QUEUE_C
+
+#include <stdlib.h>
+
+#include "queue.h"
+
+/* capacity is rounded up to a power of two */
+struct queue_t *queue_create(unsigned int capacity) {
+	struct queue_t *q;
+	unsigned long size = 2, i;
+
+	while ( size < capacity )
+		size <<= 1;
+
+	q = malloc(sizeof(struct queue_t));
+	if ( q == NULL )
+		return NULL;
+	q->cells = malloc(sizeof(struct cell_t) * size);
+	if ( q->cells == NULL ) {
+		free(q);
+		return NULL;
+	}
+
+	for ( i = 0 ; i < size ; i++ ) {
+		q->cells[i].sequence = i;
+		q->cells[i].data = NULL;
+	}
+	q->mask = size - 1;
+	q->enqueue_pos = 0;
+	q->dequeue_pos = 0;
+
+	return q;
+}
+
+void queue_destroy(struct queue_t *q) {
+	if ( q == NULL )
+		return;
+	free(q->cells);
+	free(q);
+}
+
+/* returns 0, or -1 if the queue is full */
+int queue_push(struct queue_t *q, void *data) {
+	struct cell_t *cell;
+	unsigned long pos, seq;
+	long dif;
+
+	pos = __atomic_load_n(&q->enqueue_pos, __ATOMIC_RELAXED);
+	while ( 1 ) {
+		cell = &q->cells[pos & q->mask];
+		seq = __atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE);
+		dif = (long)seq - (long)pos;
+		if ( dif == 0 ) {
+			/* the cell is free: try to claim it */
+			if ( __atomic_compare_exchange_n(&q->enqueue_pos, &pos, pos + 1, 
+						1, __ATOMIC_RELAXED, __ATOMIC_RELAXED) )
+				break;
+		} else if ( dif < 0 ) {
+			/* full */
+			return -1;
+		} else {
+			/* another producer got there first */
+			pos = __atomic_load_n(&q->enqueue_pos, __ATOMIC_RELAXED);
+		}
+	}
+
+	cell->data = data;
+	__atomic_store_n(&cell->sequence, pos + 1, __ATOMIC_RELEASE);
+
+	return 0;
+}
+
+/* returns NULL if the queue is empty */
+void *queue_pop(struct queue_t *q) {
+	struct cell_t *cell;
+	unsigned long pos, seq;
+	long dif;
+	void *data;
+
+	pos = __atomic_load_n(&q->dequeue_pos, __ATOMIC_RELAXED);
+	while ( 1 ) {
+		cell = &q->cells[pos & q->mask];
+		seq = __atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE);
+		dif = (long)seq - (long)(pos + 1);
+		if ( dif == 0 ) {
+			if ( __atomic_compare_exchange_n(&q->dequeue_pos, &pos, pos + 1, 
+						1, __ATOMIC_RELAXED, __ATOMIC_RELAXED) )
+				break;
+		} else if ( dif < 0 ) {
+			/* empty */
+			return NULL;
+		} else {
+			pos = __atomic_load_n(&q->dequeue_pos, __ATOMIC_RELAXED);
+		}
+	}
+
+	data = cell->data;
+	/* hand the cell back to the producers, one lap later */
+	__atomic_store_n(&cell->sequence, pos + q->mask + 1, __ATOMIC_RELEASE);
+
+	return data;
+}
+
+#endif
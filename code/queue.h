@@ -0,0 +1,33 @@
+#ifndef _QUEUE_H
+#define _QUEUE_H
+
+/*
+ * bounded lock-free multi-producer multi-consumer queue of pointers
+ * (D. Vyukov's array-based design): one sequence number per cell, a
+ * single compare-and-swap per operation, no locks.
+ *
+ * queue_push() fails when the queue is full and queue_pop() returns
+ * NULL when it is empty; the callers decide how to wait.
+ */
+struct cell_t {
+	unsigned long sequence;
+	void *data;
+};
+
+struct queue_t {
+	struct cell_t *cells;
+	unsigned long mask;
+	/* producers and consumers touch different cache lines */
+	char pad0[64];
+	unsigned long enqueue_pos;
+	char pad1[64];
+	unsigned long dequeue_pos;
+	char pad2[64];
+};
+
+struct queue_t *queue_create(unsigned int capacity);
+void queue_destroy(struct queue_t *q);
+int queue_push(struct queue_t *q, void *data);
+void *queue_pop(struct queue_t *q);
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef _RNG_H
+#define _RNG_H
+
+#include <stdint.h>
+
+/* random number generation library */
+#include "SFMT.h"
+
+/*
+ * keyed random streams, used in deterministic mode.
+ *
+ * A stream is identified by a key derived from the logical work item
+ * (run seed, evaluation number, session number...) and not from the
+ * thread that happens to execute it, so a run gives the same results
+ * whatever the number of threads.
+ *
+ * Everywhere a 'struct rng_t *' is accepted, NULL means the global SFMT
+ * sequence (the original, sequential behaviour).
+ */
+struct rng_t {
+	uint64_t state;
+};
+
+/* what a key is used for, so that streams never overlap */
+enum key_phase_e { KEY_TRAINING = 1, KEY_TESTING, KEY_WEIGHTS, KEY_BREEDING };
+
+/* splitmix64 finaliser */
+static inline uint64_t rng_mix(uint64_t z) {
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+/* derive the key of a sub-item (e.g. session 'item' of an evaluation) */
+static inline uint64_t rng_key(uint64_t key, uint64_t item) {
+	return rng_mix(key ^ rng_mix(item + 0x9e3779b97f4a7c15ULL));
+}
+
+static inline void rng_init(struct rng_t *r, uint64_t key) {
+	r->state = key;
+}
+
+static inline uint32_t rng_next32(struct rng_t *r) {
+	r->state += 0x9e3779b97f4a7c15ULL;
+	return (uint32_t)(rng_mix(r->state) >> 32);
+}
+
+/* same contract as genrand_real3(): uniform on the open interval (0,1) */
+static inline double rng_real3(struct rng_t *r) {
+	return ((double)rng_next32(r) + 0.5) * (1.0/4294967296.0);
+}
+
+/* draw from a keyed stream, or from SFMT when there is none */
+static inline uint32_t draw_u32(struct rng_t *r) {
+	return r != NULL ? rng_next32(r) : gen_rand32();
+}
+
+static inline double draw_real3(struct rng_t *r) {
+	return r != NULL ? rng_real3(r) : genrand_real3();
+}
+
+#endif
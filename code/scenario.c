@@ -2,42 +2,63 @@
 #define _SCENARIO_C
 
 #include "scenario.h"
+#include "trace.h"
 
 /******************* scenario handling **************/
 
-inline void dbg(char* message) {
-#ifdef DBG
-	printf(message);
-#endif
-}
+static void fill_scenario(struct scenario_t *s, struct rng_t *rng);
 
 struct scenario_t *gen_scenario() {
-	float a, b;
+	return gen_scenario_rng(NULL);
+}
+
+/* generate a scenario drawing from the given stream (NULL for SFMT) */
+struct scenario_t *gen_scenario_rng(struct rng_t *rng) {
 	struct scenario_t *s;
 	s = malloc(sizeof(struct scenario_t));
 	s->obj1 = malloc(sizeof(struct object_t));
 	s->obj2 = malloc(sizeof(struct object_t));
 	s->sensor = malloc(sizeof(struct sensor_t));
 
+	fill_scenario(s, rng);
+
+	return s;
+}
+
+/* generate a scenario into preallocated storage, without allocating */
+struct scenario_t *init_scenario_buf(struct scenario_buf_t *b, struct rng_t *rng) {
+	b->scenario.obj1 = &b->obj1;
+	b->scenario.obj2 = &b->obj2;
+	b->scenario.sensor = &b->sensor;
+
+	fill_scenario(&b->scenario, rng);
+
+	return &b->scenario;
+}
+
+/* draw the objects of a scenario and reset its sensor */
+static void fill_scenario(struct scenario_t *s, struct rng_t *rng) {
+	float a, b;
+
 	/* the first object in the first half of the space */
-	a = genrand_real3() * 0.4 + 0.05;
-	b = genrand_real3() * 0.4 + 0.05;
+	a = draw_real3(rng) * 0.4 + 0.05;
+	b = draw_real3(rng) * 0.4 + 0.05;
 	
 	s->obj1->start_x = a < b ? a : b;
 	s->obj1->end_x = a > b ? a : b;
 
 	/* the second object, in the second half of the space */
-	a = genrand_real3() * 0.4 + 0.55;
-	b = genrand_real3() * 0.4 + 0.55;
+	a = draw_real3(rng) * 0.4 + 0.55;
+	b = draw_real3(rng) * 0.4 + 0.55;
 
 	s->obj2->start_x = a < b ? a : b;
 	s->obj2->end_x = a > b ? a : b;
 
 	/* generate distances */
-	a = genrand_real3() * 0.4 + 0.05;
-	b = genrand_real3() * 0.4 + 0.55;
+	a = draw_real3(rng) * 0.4 + 0.05;
+	b = draw_real3(rng) * 0.4 + 0.55;
 
-	if ( gen_rand32() % 2 == 0 ) {
+	if ( draw_u32(rng) % 2 == 0 ) {
 		/* first object is closer */
 		s->obj1->start_y = a;
 		s->obj2->start_y = b;
@@ -55,11 +76,16 @@ struct scenario_t *gen_scenario() {
 	s->obj1->end_y = s->obj1->start_y + OBJECT_DEPTH;
 	s->obj2->end_y = s->obj2->start_y + OBJECT_DEPTH;
 
-	/* place sensor at initial position */
-	s->sensor->pos = 0.0;
-	s->sensor->angle = M_PI_2;	/* facing up */
+	reset_sensor(s->sensor);
+}
 
-	return s;
+/* place sensor at initial position */
+void reset_sensor(struct sensor_t *sensor) {
+	sensor->pos = 0.0;
+	sensor->angle = M_PI_2;	/* facing up */
+	sensor->lateral_steps = 0;
+	sensor->angular_steps = 0;
+	sensor->outcome = 0;
 }
 
 void destroy_scenario(struct scenario_t *s) {
@@ -138,9 +164,8 @@ static void get_angular_coeff(struct object_t *obj, float sens_pos, float sens_a
 }
 
 /* verifies the condition */
-static int verify_condition(struct scenario_t *scenario, enum condition_e condition, struct condition_t *now) {
+static inline int verify_condition(struct scenario_t *scenario, enum condition_e condition, struct condition_t *now) {
 
-	dbg("verifying condition: ");
 	/* angular coefficient of the occupancy of the object */
 	float m1_obj1, m2_obj1, m1_obj2, m2_obj2;
 	int found_obj1, found_obj2;
@@ -168,15 +193,14 @@ static int verify_condition(struct scenario_t *scenario, enum condition_e condit
 	/* if we're in front of the object, it's the opposite */
 	if ( now->sensor_pos > scenario->obj1->start_x && 
 			now->sensor_pos < scenario->obj1->end_x ) {
-		dbg("in front of obj1; ");
 		found_obj1 = ( found_obj1 == 1 ) ? 0 : 1;
 	}
 
 	/* we were looking for the object and we found it */
 	if ( condition == OBJECT && found_obj1 == 1 ) {
-		dbg("condition verified, object found\n");
 		/* update sensor status */
 		now->sensor_status = 1;
+		trace(TR_CONDITION, condition, 1, now->sensor_pos, now->sensor_angle);
 		return 1;
 	}
 
@@ -184,8 +208,8 @@ static int verify_condition(struct scenario_t *scenario, enum condition_e condit
 	 * -- this test is done here to avoid 'transparency', i.e.
 	 *  seeing through objects */
 	if ( condition == NON_OBJECT && found_obj1 == 1 ) {
-		dbg("condition not verified, object found\n");
 		now->sensor_status = 1;
+		trace(TR_CONDITION, condition, 0, now->sensor_pos, now->sensor_angle);
 		return 0;
 	}
 
@@ -203,21 +227,20 @@ static int verify_condition(struct scenario_t *scenario, enum condition_e condit
 	/* if we're in front of the object, it's the opposite */
 	if ( now->sensor_pos > scenario->obj2->start_x && 
 			now->sensor_pos < scenario->obj2->end_x ) {
-		dbg("in front of obj2; ");
 		found_obj2 = ( found_obj2 == 1 ) ? 0 : 1;
 	} 
 
 	/* we were looking for the object and we found it */
 	if ( condition == OBJECT && found_obj2 == 1 ) {
-		dbg("condition verified, object found\n");
 		now->sensor_status = 1;
+		trace(TR_CONDITION, condition, 1, now->sensor_pos, now->sensor_angle);
 		return 1;
 	}
 
 	/* or we were not looking for any object and we did not find any */
 	if ( condition == NON_OBJECT && found_obj1 == 0 && found_obj2 == 0 ) {
-		dbg("condition verified, object not found\n");
 		now->sensor_status = 0; 
+		trace(TR_CONDITION, condition, 1, now->sensor_pos, now->sensor_angle);
 		return 1;
 	}
 
@@ -226,30 +249,59 @@ static int verify_condition(struct scenario_t *scenario, enum condition_e condit
 		now->sensor_status = 0;
 
 	/* otherwise the condition has not been fulfilled */
-	dbg("Condition not verified\n");
+	trace(TR_CONDITION, condition, 0, now->sensor_pos, now->sensor_angle);
 	return 0;
 
 }
 
 
+/* step budgets, none by default */
+struct budget_t BUDGET = { 0, 0 };
+
+/*
+ * may the sensor take one more step in this action?
+ * returns 0 if so, or -2 (and records why) if a budget is spent
+ */
+static inline int check_budget(struct scenario_t *scenario, unsigned int action_steps) {
+	struct sensor_t *sensor = scenario->sensor;
+
+	if ( BUDGET.action_steps > 0 && action_steps >= BUDGET.action_steps ) {
+		trace(TR_OUT_OF_BUDGET, OUT_OF_ACTION_BUDGET, action_steps, sensor->pos, sensor->angle);
+		sensor->outcome |= OUT_OF_ACTION_BUDGET;
+		return -2;
+	}
+	if ( BUDGET.strategy_steps > 0 
+			&& sensor->lateral_steps + sensor->angular_steps >= BUDGET.strategy_steps ) {
+		trace(TR_OUT_OF_BUDGET, OUT_OF_STRATEGY_BUDGET, 
+				sensor->lateral_steps + sensor->angular_steps, sensor->pos, sensor->angle);
+		sensor->outcome |= OUT_OF_STRATEGY_BUDGET;
+		return -2;
+	}
+	return 0;
+}
+
 /** 
  * execute atomic action
  */
-static int do_move(struct scenario_t *scenario, enum condition_e condition, struct condition_t *now, int direction) {
+static inline int do_move(struct scenario_t *scenario, enum condition_e condition, struct condition_t *now, int direction) {
+	unsigned int steps = 0;
 	do {
 		if ( now->sensor_pos > 1.0 ) {
 			now->sensor_pos = 1.0;
 			/* end of rail */
-			dbg("End of rail\n");
+			trace(TR_END_OF_RAIL, 0, 0, now->sensor_pos, now->sensor_angle);
 			return -1;
 		}
 		if ( now->sensor_pos < 0 ) {
 			now->sensor_pos = 0.0;
-			dbg("End of rail\n");
+			trace(TR_END_OF_RAIL, 0, 0, now->sensor_pos, now->sensor_angle);
 			return -1;
 		}
+		if ( check_budget(scenario, steps++) < 0 )
+			return -2;
 		/* step movement */
 		now->sensor_pos += direction * SENSOR_LATERALSTEP;
+		scenario->sensor->lateral_steps++;
 	} while ( verify_condition(scenario, condition, now) == 0 );
 
 	return 0;
@@ -258,38 +310,45 @@ static int do_move(struct scenario_t *scenario, enum condition_e condition, stru
 /** 
  * execute atomic action
  */
-static int do_rotate(struct scenario_t *scenario, enum condition_e condition, struct condition_t *now, int direction) {
+static inline int do_rotate(struct scenario_t *scenario, enum condition_e condition, struct condition_t *now, int direction) {
+	unsigned int steps = 0;
 	do { 
 		if ( now->sensor_angle > M_PI ) {
 			now->sensor_angle = M_PI - SENSOR_ANGULARSTEP;
-			dbg("End of platform\n");
+			trace(TR_END_OF_PLATFORM, 0, 0, now->sensor_pos, now->sensor_angle);
 			return -1;
 		}
 		if ( now->sensor_angle < 0 ) {
-			dbg("End of platform\n");
+			trace(TR_END_OF_PLATFORM, 0, 0, now->sensor_pos, now->sensor_angle);
 			now->sensor_angle = 0.0 + SENSOR_ANGULARSTEP;
 			return -1;
 		}
 
+		if ( check_budget(scenario, steps++) < 0 )
+			return -2;
 		now->sensor_angle += direction * SENSOR_ANGULARSTEP;
+		scenario->sensor->angular_steps++;
 	} while ( verify_condition(scenario, condition, now) == 0 );
 
 	return 0;
 }
 
-static int do_skip(struct scenario_t *scenario, struct condition_t *now, int direction) {
+static inline int do_skip(struct scenario_t *scenario, struct condition_t *now, int direction) {
 	if ( now->sensor_pos > 1.0 ) {
 		now->sensor_pos = 1.0;
-		dbg("End of rail\n");
+		trace(TR_END_OF_RAIL, 0, 0, now->sensor_pos, now->sensor_angle);
 		return -1;
 	}
 	if ( now->sensor_pos < 0 ) {
 		now->sensor_pos = 0.0;
-		dbg("End of rail\n");
+		trace(TR_END_OF_RAIL, 0, 0, now->sensor_pos, now->sensor_angle);
 		return -1;
 	}
 
+	if ( check_budget(scenario, 0) < 0 )
+		return -2;
 	now->sensor_pos += direction * SENSOR_SKIPSTEP;
+	scenario->sensor->lateral_steps++;
 
 	/* check if the object is in front of us */
 	enum condition_e condition = OBJECT;
@@ -304,44 +363,40 @@ static int do_skip(struct scenario_t *scenario, struct condition_t *now, int dir
  * saves the current condition in 'now'
  *
  * returns -1 if other error (end of rail, etc);
+ * returns -2 if out of step budget
  */
 static int execute_action(struct scenario_t *scenario, enum action_e action, enum condition_e condition, struct condition_t *now) {
 	int ret = 0;
-	dbg("\n>>new action: ");
 
 	/* init the current environment
 	 * so that we will update only rotation or position */
 	now->sensor_pos = scenario->sensor->pos;
 	now->sensor_angle = scenario->sensor->angle;
 	/* sensor status is evaluated at every action */
+	trace(TR_ACTION_START, action, condition, now->sensor_pos, now->sensor_angle);
 
 	switch (action) {
 		case MOVE_LEFT:
-			dbg("moving left\n");
 			ret = do_move(scenario, condition, now, -1.0);
 			break;
 		case MOVE_RIGHT:
-			dbg("moving right\n");
 			ret = do_move(scenario, condition, now, 1.0);
 			break;
 		case ROTATE_LEFT:
-			dbg("rotating left\n");
 			ret = do_rotate(scenario, condition, now, 1.0);
 			break;
 		case ROTATE_RIGHT:
-			dbg("rotating right\n");
 			ret = do_rotate(scenario, condition, now, -1.0);
 			break;
 		case SKIP_LEFT:
-			dbg("skip left\n");
 			ret = do_skip(scenario, now, -1.0);
 			break;
 		case SKIP_RIGHT:
-			dbg("skip right\n");
 			ret = do_skip(scenario, now, 1.0);
 			break;
 		/* no default */
 	}
+	trace(TR_ACTION_END, action, ret, now->sensor_pos, now->sensor_angle);
 
 	return ret;
 
@@ -353,7 +408,7 @@ static int run_strategy(char* strategy, struct scenario_t *scenario, struct cond
 
 	enum action_e action;
 	enum condition_e condition;
-	int move, count;
+	int move, count, ret;
 	
 	move = 0; /* beginning of strategy */
 	count = 0;
@@ -364,10 +419,10 @@ static int run_strategy(char* strategy, struct scenario_t *scenario, struct cond
 			fprintf(stderr, "unexpected end of strategy reached");
 			return -1;
 		}
-		/* returns -1 if end-of-rail, etc;
-		 * not checked here, useful in future?
+		/* returns -1 if end-of-rail, etc: not checked here;
+		 * -2 if out of step budget: the run stops after this action
 		 */
-		execute_action(scenario, action, condition, &now[count]);
+		ret = execute_action(scenario, action, condition, &now[count]);
 
 		/* update status */
 		scenario->sensor->angle = now->sensor_angle;
@@ -375,6 +430,8 @@ static int run_strategy(char* strategy, struct scenario_t *scenario, struct cond
 		/* sensor status is evaluated for every action */
 
 		count++;
+		if ( ret == -2 )
+			break;
 	}
 
 	/* returns the number of actions */
@@ -388,6 +445,10 @@ int run_strategy_mem(char* strategy, struct scenario_t *scenario, fann_type *des
 	int i, j; 
 	struct condition_t now[num_actions];
 
+	/* run_strategy() does not fill every slot; never hand out
+	 * uninitialised stack memory, it would make runs irreproducible */
+	memset(now, 0, sizeof(now));
+
 	/* run strategy */
 	if ( run_strategy(strategy, scenario, now, num_actions) < 0 )
 		/* problem here */
@@ -404,4 +465,184 @@ int run_strategy_mem(char* strategy, struct scenario_t *scenario, fann_type *des
 	
 }
 
+/*
+ * the normal form of a strategy's behaviour: strategies with the same
+ * normal form give the same inputs, steps and outcomes in every
+ * scenario, so they only need evaluating once.
+ * - run_strategy() only runs the first half of the genes, rounded up:
+ *   the others just size the network, they become MOVE_LEFT/NON_OBJECT
+ * - skipping ignores the condition, it becomes NON_OBJECT
+ * - a trailing half gene is never read, it goes
+ * 'dest' has room for strlen(strategy)+1 bytes.
+ */
+void canonical_strategy(char *dest, char *strategy) {
+	int num_actions = get_num_actions(strategy);
+	int executed = (num_actions + 1) / 2;
+	int i;
+
+	for ( i = 0 ; i < num_actions ; i++ ) {
+		dest[2*i] = strategy[2*i];
+		dest[2*i+1] = strategy[2*i+1];
+		if ( i >= executed ) {
+			dest[2*i] = MOVE_LEFT;
+			dest[2*i+1] = NON_OBJECT;
+		} else if ( dest[2*i] == SKIP_LEFT || dest[2*i] == SKIP_RIGHT ) {
+			dest[2*i+1] = NON_OBJECT;
+		}
+	}
+	dest[2*num_actions] = '\0';
+}
+
+/*************** compiled strategies ******************/
+
+/*
+ * one handler per (action, condition) pair, with direction and
+ * condition known at compile time so that do_move()/do_rotate() and
+ * verify_condition() are specialised for each of them, traced as
+ * execute_action() is
+ */
+#define TRACED_OP(name, action, cond, call) \
+	static int name(struct scenario_t *scenario, struct condition_t *now) { \
+		int ret; \
+		trace(TR_ACTION_START, action, cond, now->sensor_pos, now->sensor_angle); \
+		ret = call; \
+		trace(TR_ACTION_END, action, ret, now->sensor_pos, now->sensor_angle); \
+		return ret; \
+	}
+#define MOVE_OP(name, action, cond, dir) \
+	TRACED_OP(name, action, cond, do_move(scenario, cond, now, dir))
+#define ROTATE_OP(name, action, cond, dir) \
+	TRACED_OP(name, action, cond, do_rotate(scenario, cond, now, dir))
+/* skipping ignores the condition */
+#define SKIP_OP(name, action, cond, dir) \
+	TRACED_OP(name, action, cond, do_skip(scenario, now, dir))
+
+MOVE_OP(move_left_non_object, MOVE_LEFT, NON_OBJECT, -1)
+MOVE_OP(move_left_object, MOVE_LEFT, OBJECT, -1)
+MOVE_OP(move_right_non_object, MOVE_RIGHT, NON_OBJECT, 1)
+MOVE_OP(move_right_object, MOVE_RIGHT, OBJECT, 1)
+ROTATE_OP(rotate_left_non_object, ROTATE_LEFT, NON_OBJECT, 1)
+ROTATE_OP(rotate_left_object, ROTATE_LEFT, OBJECT, 1)
+ROTATE_OP(rotate_right_non_object, ROTATE_RIGHT, NON_OBJECT, -1)
+ROTATE_OP(rotate_right_object, ROTATE_RIGHT, OBJECT, -1)
+SKIP_OP(skip_left_non_object, SKIP_LEFT, NON_OBJECT, -1)
+SKIP_OP(skip_left_object, SKIP_LEFT, OBJECT, -1)
+SKIP_OP(skip_right_non_object, SKIP_RIGHT, NON_OBJECT, 1)
+SKIP_OP(skip_right_object, SKIP_RIGHT, OBJECT, 1)
+
+/* unknown action: execute_action() does nothing either */
+static int no_op(struct scenario_t *scenario, struct condition_t *now) {
+	return 0;
+}
+
+/* indexed by [action-1][condition-1] */
+static const op_fn OPS[6][2] = {
+	{ move_left_non_object, move_left_object },
+	{ move_right_non_object, move_right_object },
+	{ rotate_left_non_object, rotate_left_object },
+	{ rotate_right_non_object, rotate_right_object },
+	{ skip_left_non_object, skip_left_object },
+	{ skip_right_non_object, skip_right_object },
+};
+
+static op_fn decode_op(enum action_e action, enum condition_e condition) {
+	if ( action < MOVE_LEFT || action > SKIP_RIGHT 
+			|| condition < NON_OBJECT || condition > OBJECT )
+		return no_op;
+	return OPS[action-1][condition-1];
+}
+
+struct program_t *compile_strategy(char *strategy) {
+	struct program_t *p;
+
+	p = malloc(sizeof(struct program_t));
+	if ( p == NULL )
+		return NULL;
+	p->ops = NULL;
+	p->max_ops = 0;
+	if ( compile_strategy_into(p, strategy) < 0 ) {
+		destroy_program(p);
+		return NULL;
+	}
+
+	return p;
+}
+
+/*
+ * decode a strategy, once, into the handlers run_strategy() would end
+ * up calling: same actions, in the same order, for the same slots.
+ * The program is reused: it only allocates to grow.
+ */
+int compile_strategy_into(struct program_t *p, char *strategy) {
+	enum action_e action;
+	enum condition_e condition;
+	int move = 0, count, i;
+
+	p->num_actions = get_num_actions(strategy);
+	/* run_strategy() moves two slots per action */
+	p->num_ops = (p->num_actions + 1) / 2;
+	if ( p->num_ops > p->max_ops ) {
+		op_fn *ops = realloc(p->ops, sizeof(op_fn) * p->num_ops);
+		if ( ops == NULL )
+			return -1;
+		p->ops = ops;
+		p->max_ops = p->num_ops;
+	}
+
+	for ( count = 0, i = 0 ; count < p->num_actions ; count += 2, i++ ) {
+		if ( parse_strategy(strategy, &move, &action, &condition) == 0 )
+			p->ops[i] = no_op;
+		else
+			p->ops[i] = decode_op(action, condition);
+	}
+
+	return 0;
+}
+
+void destroy_program(struct program_t *p) {
+	if ( p == NULL )
+		return;
+	free(p->ops);
+	free(p);
+}
+
+/* 
+ * run a compiled strategy: no decoding, no switch.
+ * 'now' is scratch space for p->num_actions conditions.
+ */
+int run_program_mem(struct program_t *p, struct scenario_t *scenario, fann_type *dest, int dest_len, 
+		struct condition_t *now) {
+	int i, j, ret;
+	struct condition_t *slot;
+
+	memset(now, 0, sizeof(struct condition_t) * p->num_actions);
+
+	for ( i = 0 ; i < p->num_ops ; i++ ) {
+		slot = &now[2 * i];
+
+		/* as in execute_action(): start from the sensor position */
+		slot->sensor_pos = scenario->sensor->pos;
+		slot->sensor_angle = scenario->sensor->angle;
+
+		ret = p->ops[i](scenario, slot);
+
+		/* as in run_strategy(): the sensor follows the first slot */
+		scenario->sensor->angle = now[0].sensor_angle;
+		scenario->sensor->pos = now[0].sensor_pos;
+
+		/* and out of step budget, the run stops */
+		if ( ret == -2 )
+			break;
+	}
+
+	/* copy into already prepared data structure */
+	for ( i = 0, j = 0 ; i < p->num_actions && j < dest_len ; i++ ) {
+		dest[j++] = now[i].sensor_pos;
+		dest[j++] = now[i].sensor_angle;
+		dest[j++] = now[i].sensor_status;
+	}
+
+	return 0;
+}
+
 #endif
@@ -7,6 +7,7 @@
 
 /* random number generation library */
 #include "SFMT.h"
+#include "rng.h"
 
 /* FANN library */
 #include "floatfann.h"
@@ -26,8 +27,25 @@ struct object_t {
 struct sensor_t {
 	float angle;	
 	float pos;
+	/* steps taken so far: what a strategy costs on the device */
+	unsigned int lateral_steps;
+	unsigned int angular_steps;
+	unsigned int outcome;	/* budgets run out, see outcome_e */
 };
 
+/*
+ * step budgets, 0 for none: an action that would take more than
+ * 'action_steps' steps, or the strategy more than 'strategy_steps' in
+ * total, stops there, and so does the strategy run
+ */
+struct budget_t {
+	unsigned int action_steps;
+	unsigned int strategy_steps;
+};
+extern struct budget_t BUDGET;
+
+enum outcome_e { OUT_OF_ACTION_BUDGET = 1, OUT_OF_STRATEGY_BUDGET = 2 };
+
 struct scenario_t {
 	struct object_t *obj1;
 	struct object_t *obj2;
@@ -36,6 +54,13 @@ struct scenario_t {
 	float nearest_object_centre;
 };
 
+/* a scenario with its own storage, to be reused without allocating */
+struct scenario_buf_t {
+	struct scenario_t scenario;
+	struct object_t obj1, obj2;
+	struct sensor_t sensor;
+};
+
 struct condition_t {
 	float sensor_pos;
 	float sensor_angle;
@@ -53,7 +78,10 @@ static const int NUM_CONDITIONS = 2;
 
 
 struct scenario_t *gen_scenario();
+struct scenario_t *gen_scenario_rng(struct rng_t *rng);
+struct scenario_t *init_scenario_buf(struct scenario_buf_t *b, struct rng_t *rng);
 void destroy_scenario(struct scenario_t *scenario);
+void reset_sensor(struct sensor_t *sensor);
 void init_conditions(struct condition_t *now);
 
 inline int get_input_neurones(char* strategy);
@@ -62,5 +90,22 @@ int run_strategy_disk(char* strategy, struct scenario_t *scenario,
 		char* filename, int len);
 int run_strategy_mem(char* strategy, struct scenario_t *scenario, 
 		fann_type* dest, int len);
+void canonical_strategy(char *dest, char *strategy);
+
+/* a strategy compiled into one handler per executed action */
+typedef int (*op_fn)(struct scenario_t *scenario, struct condition_t *now);
+
+struct program_t {
+	int num_actions;	/* actions in the strategy, i.e. output slots */
+	int num_ops;		/* handlers actually executed */
+	int max_ops;		/* room in 'ops' */
+	op_fn *ops;
+};
+
+struct program_t *compile_strategy(char *strategy);
+int compile_strategy_into(struct program_t *p, char *strategy);
+void destroy_program(struct program_t *p);
+int run_program_mem(struct program_t *p, struct scenario_t *scenario, 
+		fann_type *dest, int len, struct condition_t *now);
 
 #endif	
@@ -0,0 +1,284 @@
+#ifndef _SERVER_C
+#define _SERVER_C
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "server.h"
+#include "evolution.h"
+#include "context.h"
+
+/* the longest strategy accepted, in bytes */
+#define SERVER_MAX_STRATEGY 256
+/* candidates in a request */
+#define SERVER_MAX_BATCH 65536
+#define SERVER_LINE (SERVER_MAX_STRATEGY + 2)
+
+/* requests in progress, waited for before stopping */
+static pthread_mutex_t requests_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t requests_done = PTHREAD_COND_INITIALIZER;
+static int running_requests = 0;
+
+/* a client being served */
+struct client_t {
+	int fd;
+	FILE *in;
+	pthread_mutex_t write_lock;	/* results come from the pipeline threads */
+	char **strategies;
+	unsigned int num_strategies, max_strategies;
+	struct fitness_t *fitness;
+	unsigned int max_fitness;
+};
+
+static void reply(struct client_t *c, char *line) {
+	size_t len = strlen(line), sent = 0;
+	ssize_t n;
+
+	pthread_mutex_lock(&c->write_lock);
+	/* a client gone is noticed when reading the next request */
+	while ( sent < len && (n = send(c->fd, line + sent, len - sent, MSG_NOSIGNAL)) > 0 )
+		sent += n;
+	pthread_mutex_unlock(&c->write_lock);
+}
+
+/* eval_batch() callback: stream each result as it is in */
+static void send_result(void *arg, int candidate, struct fitness_t *fitness) {
+	char line[128];
+
+	if ( fitness->failed )
+		snprintf(line, sizeof(line), "%d FAILED\n", candidate);
+	else
+		snprintf(line, sizeof(line), "%d %f %.1f %d %.2f %u\n", candidate, fitness->error,
+				fitness->steps, fitness->length, fitness->over_budget, fitness->epochs);
+	reply(arg, line);
+}
+
+/* digits into genes; returns -1 if not a strategy */
+static int parse_genes(char *line, char *strategy) {
+	size_t len = strcspn(line, "\r\n"), i;
+
+	if ( len == 0 || len % 2 != 0 || len > SERVER_MAX_STRATEGY )
+		return -1;
+	for ( i = 0 ; i < len ; i++ ) {
+		strategy[i] = line[i] - '0';
+		if ( i % 2 == 0 && (strategy[i] < 1 || strategy[i] > NUM_ACTIONS) )
+			return -1;
+		if ( i % 2 == 1 && (strategy[i] < 1 || strategy[i] > NUM_CONDITIONS) )
+			return -1;
+	}
+	strategy[len] = '\0';
+	return 0;
+}
+
+/* 
+ * read the strategies of a request, up to the empty line; after an
+ * error the rest of the request is skipped
+ */
+static int read_strategies(struct client_t *c, char *error, size_t size) {
+	char line[SERVER_LINE];
+
+	c->num_strategies = 0;
+	error[0] = '\0';
+	while ( fgets(line, SERVER_LINE, c->in) != NULL ) {
+		if ( strcspn(line, "\r\n") == 0 )
+			return error[0] == '\0' ? 0 : -1;
+		if ( error[0] != '\0' )
+			continue;
+		if ( c->num_strategies == SERVER_MAX_BATCH ) {
+			snprintf(error, size, "more than %d strategies", SERVER_MAX_BATCH);
+			continue;
+		}
+		if ( c->num_strategies == c->max_strategies ) {
+			if ( grow_buffer((void**)&c->strategies, &c->max_strategies, 
+						2 * c->max_strategies + 16, sizeof(char*)) < 0 ) {
+				snprintf(error, size, "out of memory");
+				continue;
+			}
+			memset(&c->strategies[c->num_strategies], 0, 
+					sizeof(char*) * (c->max_strategies - c->num_strategies));
+		}
+		if ( c->strategies[c->num_strategies] == NULL )
+			c->strategies[c->num_strategies] = malloc(SERVER_MAX_STRATEGY + 1);
+		if ( c->strategies[c->num_strategies] == NULL ) {
+			snprintf(error, size, "out of memory");
+			continue;
+		}
+		if ( parse_genes(line, c->strategies[c->num_strategies]) < 0 ) {
+			snprintf(error, size, "not a strategy: %.*s", 
+					(int)strcspn(line, "\r\n"), line);
+			continue;
+		}
+		c->num_strategies++;
+	}
+	snprintf(error, size, "request not terminated");
+	return -1;
+}
+
+/* one request: its parameters, its strategies, then the results */
+static int serve_request(struct client_t *c, char *request) {
+	struct run_t *run;
+	char error[SERVER_LINE + 32], line[SERVER_LINE + 64];
+	unsigned long first_id = 0;
+	int fields, ret = 0;
+
+	run = calloc(1, sizeof(struct run_t));
+	if ( run == NULL ) {
+		reply(c, "ERROR out of memory\n");
+		return -1;
+	}
+	fields = sscanf(request, "EVAL %u %u %f %d %d %lu", &run->seed, &run->max_epochs, 
+			&run->desired_error, &run->training_sessions, &run->testing_sessions, &first_id);
+	if ( fields < 5 || run->training_sessions < 1 || run->testing_sessions < 1 ) {
+		reply(c, "ERROR expected EVAL <seed> <max epochs> <desired error> "
+				"<training sessions> <testing sessions> [<first id>]\n");
+		free(run);
+		return -1;
+	}
+
+	if ( read_strategies(c, error, sizeof(error)) < 0 
+			|| grow_buffer((void**)&c->fitness, &c->max_fitness, 
+				c->num_strategies, sizeof(struct fitness_t)) < 0 ) {
+		snprintf(line, sizeof(line), "ERROR %s\n", error[0] ? error : "out of memory");
+		reply(c, line);
+		free(run);
+		return -1;
+	}
+
+	pthread_mutex_lock(&requests_lock);
+	if ( keep_going == 0 ) {
+		pthread_mutex_unlock(&requests_lock);
+		reply(c, "ERROR server stopping\n");
+		free(run);
+		return -1;
+	}
+	running_requests++;
+	pthread_mutex_unlock(&requests_lock);
+
+	run->parallel = 1;
+	if ( eval_batch(run, c->strategies, c->num_strategies, first_id, c->fitness, 
+				send_result, c) < 0 ) {
+		reply(c, "ERROR evaluation failed\n");
+		ret = -1;
+	} else {
+		snprintf(line, sizeof(line), "DONE %u\n", c->num_strategies);
+		reply(c, line);
+	}
+
+	pthread_mutex_lock(&requests_lock);
+	if ( --running_requests == 0 )
+		pthread_cond_signal(&requests_done);
+	pthread_mutex_unlock(&requests_lock);
+
+	free(run);
+	return ret;
+}
+
+/* a client thread: requests until the client hangs up */
+static void *serve_client(void *arg) {
+	struct client_t *c = arg;
+	char request[SERVER_LINE];
+	unsigned int i;
+
+	while ( keep_going && fgets(request, SERVER_LINE, c->in) != NULL ) {
+		if ( strcspn(request, "\r\n") == 0 )
+			continue;
+		serve_request(c, request);
+	}
+
+	fclose(c->in);
+	for ( i = 0 ; i < c->max_strategies ; i++ )
+		free(c->strategies[i]);
+	free(c->strategies);
+	free(c->fitness);
+	pthread_mutex_destroy(&c->write_lock);
+	free(c);
+	return NULL;
+}
+
+static void stop_serving(int sig) {
+	keep_going = 0;
+}
+
+int serve(char *path) {
+	struct sockaddr_un addr;
+	struct sigaction sa;
+	struct client_t *c;
+	pthread_t thread;
+	int listener, fd;
+
+	if ( strlen(path) >= sizeof(addr.sun_path) ) {
+		fprintf(stderr, "Socket path too long\n");
+		return -1;
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+
+	listener = socket(AF_UNIX, SOCK_STREAM, 0);
+	if ( listener < 0 ) {
+		perror("Unable to create socket");
+		return -1;
+	}
+	if ( bind(listener, (struct sockaddr *)&addr, sizeof(addr)) < 0 
+			|| listen(listener, 16) < 0 ) {
+		perror("Unable to listen on socket");
+		close(listener);
+		return -1;
+	}
+
+	/* interrupt accept() on SIGINT/SIGTERM: no SA_RESTART */
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = stop_serving;
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+	keep_going = 1;
+
+	printf("Serving on %s\n", path);
+	fflush(stdout);
+
+	while ( keep_going ) {
+		fd = accept(listener, NULL, NULL);
+		if ( fd < 0 ) {
+			if ( errno != EINTR )
+				perror("Unable to accept client");
+			continue;
+		}
+
+		c = calloc(1, sizeof(struct client_t));
+		if ( c == NULL || (c->in = fdopen(fd, "r")) == NULL ) {
+			perror("Unable to serve client");
+			free(c);
+			close(fd);
+			continue;
+		}
+		c->fd = fd;
+		pthread_mutex_init(&c->write_lock, NULL);
+		if ( pthread_create(&thread, NULL, serve_client, c) != 0 ) {
+			perror("Unable to start client thread");
+			fclose(c->in);
+			pthread_mutex_destroy(&c->write_lock);
+			free(c);
+			continue;
+		}
+		pthread_detach(thread);
+	}
+
+	close(listener);
+	unlink(path);
+
+	/* let the requests in progress finish; idle clients just go */
+	pthread_mutex_lock(&requests_lock);
+	while ( running_requests > 0 )
+		pthread_cond_wait(&requests_done, &requests_lock);
+	pthread_mutex_unlock(&requests_lock);
+	printf("Server stopped\n");
+	return 0;
+}
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef _SERVER_H
+#define _SERVER_H
+
+/*
+ * evaluation server: strategies are sent over a Unix domain socket and
+ * scored through the pipeline, which stays up between requests.
+ *
+ * A request is a line
+ *   EVAL <seed> <max epochs> <desired error> <training sessions> <testing sessions> [<first id>]
+ * then one strategy per line, as digits (e.g. 625152), then an empty
+ * line. Candidate i is evaluation 'first id + i' (0 by default) in
+ * deterministic mode, so the same request always gets the same answer.
+ *
+ * Results stream back as candidates are scored, in any order:
+ *   <i> <error> <steps> <length> <over budget> <epochs>
+ * or "<i> FAILED" for a candidate that could not be evaluated,
+ * then "DONE <n>" once all are in, or "ERROR <reason>" instead.
+ * A connection can send any number of requests; each one is served
+ * by its own thread, requests share the pipeline batch by batch.
+ */
+int serve(char *path);
+
+#endif
@@ -2,37 +2,380 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <signal.h>
+#include <unistd.h>
 
 /* random number generation library */
 #include "SFMT.h"
 
 #include "evolution.h"
+#include "parallel.h"
+#include "pipeline.h"
+#include "sweep.h"
+#include "enumerate.h"
+#include "server.h"
+#include "corpus.h"
+#include "export.h"
+#include "bench.h"
+#include "trace.h"
 
 
 inline void usage(char* progname) {
-	printf("Usage: %s <pop size> <random seed> <temp datafile> <# generations> ", progname);
+	printf("Usage: %s [options] <pop size> <random seed> <temp datafile> <# generations> ", progname);
 	printf("<max # epochs> <desired error> <strategy max length> ");
 	printf("<strategy starting length> <training sessions> <testing sessions>\n");
+	printf("       %s [options] -S <sweep file>\n", progname);
+	printf("       %s [options] -E <genes> [-C <checkpoint>] <random seed> <max # epochs> ", progname);
+	printf("<desired error> <training sessions> <testing sessions> <results table>\n");
+	printf("       %s [options] -U <socket>\n", progname);
+	printf("       %s -G <scenarios> -K <corpus> <random seed>\n", progname);
+	printf("       %s [options] -Q <report>[:<seeds>]\n", progname);
+	printf("Options:\n");
+	printf("  -j <threads>\tthreads used to simulate sessions (default 1)\n");
+	printf("  -d\t\tdeterministic mode: same results whatever the number of threads\n");
+	printf("  -p <threads>\tpipeline threads simulating sessions while the others train (default 1)\n");
+	printf("  -O <objective>\terror (default), weighted or pareto: also minimise steps and length\n");
+	printf("  -W <s>:<l>\tweighted objective: error + s * steps + l * genes (default 0.001:0.001)\n");
+	printf("  -B <a>:<s>\tstep budgets per action and per strategy run (default 0:0, none)\n");
+	printf("  -H <file>\tsave the histogram of steps per session\n");
+	printf("  -S <file>\trun every configuration of a sweep file, -j at once (see sweep.h)\n");
+	printf("  -E <genes>\tevaluate every strategy of up to <genes> genes, ranked into a table\n");
+	printf("  -C <file>\tenumeration checkpoint, resumed from if it exists\n");
+	printf("  -Q <file>[:<n>]\ttime the benchmark instances to their target errors over <n>\n");
+	printf("\t\tseeds (default %d), into a report (see bench.h)\n", BENCH_SEEDS);
+	printf("  -U <socket>\tserve evaluations on a Unix domain socket (see server.h)\n");
+	printf("  -K <corpus>\tdraw scenarios from a corpus file, shared between processes\n");
+	printf("  -G <n>\tgenerate a corpus of <n> scenarios into the -K file\n");
+	printf("  -w\t\toffspring start training from the weights of their parent\n");
+	printf("  -R <rate>\tscreen offspring with a surrogate of the fitness, evaluating\n");
+	printf("\t\tthe predicted losers at the given rate (see surrogate.h)\n");
+	printf("  -A\t\tchoose the breeding operators by their improvement per CPU second (see bandit.h)\n");
+	printf("  -N <cost>\tevolve the hidden layer size and activation of every strategy's network,\n");
+	printf("\t\tadding <cost> per connection to its error (e.g. 0.00001)\n");
+	printf("  -t <file>\ttrace the simulator and the GA into <file>: SIGUSR2 switches it\n");
+	printf("\t\toff and on, SIGUSR1 dumps it, as do crashes and exit (see trace.h)\n");
+	printf("  -X <prefix>\texport the champion: <prefix>.net and a fixed-point C module (see export.h)\n");
+	printf("  -T\t\ttrain each network on all the -j threads, sharding its training set\n");
+	printf("  -L\t\ttrain the networks of batches (-E, -U) in SIMD lanes, several at once;\n"
+			"\t\ta GA run only batches its first pair, with -d; ignored with -V or -T (see lanes.h)\n");
+	printf("  -V <v>[:<e>:<p>]\thold out a share <v> of the training sessions, check it every <e>\n");
+	printf("\t\tepochs and stop after <p> checks without improvement (default :10:3)\n");
+}
+
+/* many runs at once, one table of results */
+static int sweep(char *filename) {
+	struct run_t *runs;
+	int i, n;
+
+	n = read_sweep(filename, &runs);
+	if ( n < 0 )
+		return -1;
+
+	/* one run per thread, each on its own */
+	if ( OPTIONS.threads < 1 || par_init(OPTIONS.threads) < 0 ) {
+		fprintf(stderr,"Unable to start %d threads\n", OPTIONS.threads);
+		free(runs);
+		return -1;
+	}
+	run_sweep(runs, n);
+	par_destroy();
+
+	print_sweep(runs, n);
+
+	for ( i = 0 ; i < n ; i++ )
+		free_run(&runs[i]);
+	free(runs);
+	return 0;
+}
+
+/* the benchmark instances, one run at a time on all the threads */
+static int benchmark(char *report, int seeds) {
+	int ret;
+
+	if ( OPTIONS.threads < 1 || par_init(OPTIONS.threads) < 0 ) {
+		fprintf(stderr,"Unable to start %d threads\n", OPTIONS.threads);
+		return -1;
+	}
+	if ( OPTIONS.producers < 1 
+			|| pipe_init(OPTIONS.producers, OPTIONS.threads, 2 * OPTIONS.threads) < 0 ) {
+		fprintf(stderr,"Unable to start the pipeline\n");
+		par_destroy();
+		return -1;
+	}
+	ret = run_benchmark(report, seeds);
+	pipe_destroy();
+	destroy_batch_groups();
+	par_destroy();
+
+	return ret;
+}
+
+static void interrupt(int sig) {
+	keep_going = 0;
+}
+
+/* evaluations on demand, until interrupted */
+static int server(char *path) {
+	int ret;
+
+	if ( OPTIONS.threads < 1 || par_init(OPTIONS.threads) < 0 ) {
+		fprintf(stderr,"Unable to start %d threads\n", OPTIONS.threads);
+		return -1;
+	}
+	if ( OPTIONS.producers < 1 
+			|| pipe_init(OPTIONS.producers, OPTIONS.threads, 2 * OPTIONS.threads) < 0 ) {
+		fprintf(stderr,"Unable to start the pipeline\n");
+		par_destroy();
+		return -1;
+	}
+	ret = serve(path);
+	pipe_destroy();
+	destroy_batch_groups();
+	par_destroy();
+
+	return ret;
+}
+
+/* every short strategy, ranked */
+static int enumeration(int genes, char *checkpoint, char **argv) {
+	struct run_t run;
+	int ret;
+
+	memset(&run, 0, sizeof(struct run_t));
+	run.seed = strtol(argv[1], NULL, 10);
+	run.max_epochs = atoi(argv[2]);
+	run.desired_error = atof(argv[3]);
+	run.training_sessions = atoi(argv[4]);
+	run.testing_sessions = atoi(argv[5]);
+	printf("Random seed: %d\n", run.seed);
+
+	if ( OPTIONS.threads < 1 || par_init(OPTIONS.threads) < 0 ) {
+		fprintf(stderr,"Unable to start %d threads\n", OPTIONS.threads);
+		return -1;
+	}
+	/* stop cleanly, saving the checkpoint */
+	signal(SIGINT, interrupt);
+	ret = enumerate(&run, genes, argv[6], checkpoint);
+	signal(SIGINT, SIG_DFL);
+	par_destroy();
+
+	return ret;
 }
 
 int main ( int argc, char **argv ) {
-	int max_popsize, seed, generations, strategy_max_len,
-		strategy_starting_len, training_sessions, testing_sessions;
-	unsigned int max_epochs;
-	float desired_error;
+	struct run_t run;
+	int seed;
 	char* datafile;
+	char* progname = argv[0];
+	char* sweep_file = NULL;
+	char* checkpoint = NULL;
+	char* socket_path = NULL;
+	char* corpus_file = NULL;
+	char* export_prefix = NULL;
+	char* report = NULL;
+	int seeds = BENCH_SEEDS;
+	unsigned long corpus_size = 0;
+	int opt, genes = 0, ret;
+
+	OPTIONS.steps_weight = 0.001;
+	OPTIONS.length_weight = 0.001;
+
+	while ( (opt = getopt(argc, argv, "j:dp:O:W:B:H:S:E:C:U:K:G:wV:TLX:R:AQ:t:N:")) != -1 ) {
+		switch (opt) {
+			case 'j':
+				OPTIONS.threads = atoi(optarg);
+				break;
+			case 'd':
+				OPTIONS.deterministic = 1;
+				break;
+			case 'p':
+				OPTIONS.producers = atoi(optarg);
+				break;
+			case 'O':
+				if ( strcmp(optarg, "error") == 0 )
+					OPTIONS.objective = OBJ_ERROR;
+				else if ( strcmp(optarg, "weighted") == 0 )
+					OPTIONS.objective = OBJ_WEIGHTED;
+				else if ( strcmp(optarg, "pareto") == 0 )
+					OPTIONS.objective = OBJ_PARETO;
+				else {
+					usage(progname);
+					return -1;
+				}
+				break;
+			case 'B':
+				if ( sscanf(optarg, "%u:%u", &BUDGET.action_steps, 
+							&BUDGET.strategy_steps) != 2 ) {
+					usage(progname);
+					return -1;
+				}
+				break;
+			case 'H':
+				OPTIONS.histogram = optarg;
+				break;
+			case 'S':
+				sweep_file = optarg;
+				break;
+			case 'Q':
+				report = optarg;
+				if ( strrchr(report, ':') != NULL ) {
+					seeds = atoi(strrchr(report, ':') + 1);
+					*strrchr(report, ':') = '\0';
+				}
+				break;
+			case 'E':
+				genes = atoi(optarg);
+				break;
+			case 'C':
+				checkpoint = optarg;
+				break;
+			case 'U':
+				socket_path = optarg;
+				break;
+			case 'K':
+				corpus_file = optarg;
+				break;
+			case 'w':
+				OPTIONS.warm_start = 1;
+				break;
+			case 'R':
+				OPTIONS.surrogate = 1;
+				OPTIONS.exploration = atof(optarg);
+				if ( OPTIONS.exploration < 0 || OPTIONS.exploration > 1 ) {
+					usage(progname);
+					return -1;
+				}
+				break;
+			case 'A':
+				OPTIONS.adaptive = 1;
+				break;
+			case 'N':
+				OPTIONS.topology = 1;
+				OPTIONS.model_weight = atof(optarg);
+				if ( OPTIONS.model_weight < 0 ) {
+					usage(progname);
+					return -1;
+				}
+				break;
+			case 't':
+				/* dumped on the way out, whatever the mode */
+				if ( trace_open(optarg) < 0 ) {
+					usage(progname);
+					return -1;
+				}
+				atexit(trace_close);
+				break;
+			case 'X':
+				export_prefix = optarg;
+				break;
+			case 'T':
+				OPTIONS.sharded_training = 1;
+				break;
+			case 'L':
+				OPTIONS.lanes = 1;
+				break;
+			case 'V':
+				if ( sscanf(optarg, "%f:%u:%u", &OPTIONS.validation, 
+							&OPTIONS.check_every, &OPTIONS.patience) < 1 
+						|| OPTIONS.validation <= 0 || OPTIONS.validation >= 1 ) {
+					usage(progname);
+					return -1;
+				}
+				break;
+			case 'G':
+				corpus_size = strtoul(optarg, NULL, 10);
+				break;
+			case 'W':
+				if ( sscanf(optarg, "%f:%f", &OPTIONS.steps_weight, 
+							&OPTIONS.length_weight) != 2 ) {
+					usage(progname);
+					return -1;
+				}
+				break;
+			default:
+				usage(progname);
+				return -1;
+		}
+	}
+	/* positional arguments follow the options */
+	argc -= optind - 1;
+	argv += optind - 1;
+
+	if ( corpus_size > 0 ) {
+		if ( argc != 2 || corpus_file == NULL ) {
+			usage(progname);
+			return -1;
+		}
+		return write_corpus(corpus_file, corpus_size, strtoull(argv[1], NULL, 10));
+	}
+
+	if ( corpus_file != NULL ) {
+		OPTIONS.corpus = open_corpus(corpus_file);
+		if ( OPTIONS.corpus == NULL )
+			return -1;
+	}
+
+	if ( sweep_file != NULL ) {
+		if ( argc != 1 ) {
+			usage(progname);
+			return -1;
+		}
+		/* the runs cannot share the SFMT stream */
+		OPTIONS.deterministic = 1;
+		ret = sweep(sweep_file);
+		close_corpus(OPTIONS.corpus);
+		return ret;
+	}
+
+	if ( report != NULL ) {
+		if ( argc != 1 ) {
+			usage(progname);
+			return -1;
+		}
+		ret = benchmark(report, seeds);
+		close_corpus(OPTIONS.corpus);
+		return ret;
+	}
+
+	if ( socket_path != NULL ) {
+		if ( argc != 1 ) {
+			usage(progname);
+			return -1;
+		}
+		/* answers depend on the request only */
+		OPTIONS.deterministic = 1;
+		ret = server(socket_path);
+		close_corpus(OPTIONS.corpus);
+		return ret;
+	}
+
+	if ( genes > 0 ) {
+		if ( argc != 7 ) {
+			usage(progname);
+			return -1;
+		}
+		/* strategy i is evaluation i */
+		OPTIONS.deterministic = 1;
+		ret = enumeration(genes, checkpoint, argv);
+		close_corpus(OPTIONS.corpus);
+		return ret;
+	}
 
 	if ( argc != 11 ) {
-		usage(argv[0]);
+		usage(progname);
 		return -1;
 	}
 
+	memset(&run, 0, sizeof(struct run_t));
+	run.parallel = 1;
+	run.verbose = 1;
+
 	/* first arg is max population size */
-	max_popsize = atoi(argv[1]);
+	run.popsize = atoi(argv[1]);
 
 	/* second arg is random seed */
 	seed = strtol(argv[2], NULL, 10);
 	init_gen_rand(seed);
+	run.seed = seed;
 	printf("Random seed: %d\n", seed);
 
 	/* third arg is temporary datafile, test-open for reading and writing */
@@ -47,42 +390,52 @@ int main ( int argc, char **argv ) {
 		/* test passed; will re-open later */
 		fclose(f);
 	}
+	run.datafile = datafile;
 
 	/* fourth arg is no. of generations */
-	generations = atoi(argv[4]);
-	if ( generations <= 0 ) {
+	run.generations = atoi(argv[4]);
+	if ( run.generations <= 0 ) {
 		fprintf(stderr,"Negative generations?\n");
 		return -1;
 	}
 
 	/* fifth arg is no. of epochs */
-	max_epochs = atoi(argv[5]);
+	run.max_epochs = atoi(argv[5]);
 
 	/* sixth arg is desired error for neural network */
-	desired_error = atof(argv[6]);
+	run.desired_error = atof(argv[6]);
 
 	/* seventh arg is strategy max length */
-	strategy_max_len = atoi(argv[7]);
+	run.max_len = atoi(argv[7]);
 	
 	/* eighth arg is strategy starting length */
-	strategy_starting_len = atoi(argv[8]);
+	run.starting_len = atoi(argv[8]);
+
+	run.training_sessions = atoi(argv[9]);
+	run.testing_sessions = atoi(argv[10]);
 
-	training_sessions = atoi(argv[9]);
-	testing_sessions = atoi(argv[10]);
+	if ( OPTIONS.threads < 1 || par_init(OPTIONS.threads) < 0 ) {
+		fprintf(stderr,"Unable to start %d threads\n", OPTIONS.threads);
+		return -1;
+	}
 
-	/* initialise population */
-	if ( hcreate(max_popsize) == 0 ) {
-		perror("Unable to allocate population");
-		hdestroy();
+	/* batches: producers simulate, one consumer per thread trains */
+	if ( OPTIONS.producers < 1 
+			|| pipe_init(OPTIONS.producers, OPTIONS.threads, 2 * OPTIONS.threads) < 0 ) {
+		fprintf(stderr,"Unable to start the pipeline\n");
+		par_destroy();
 		return -1;
 	}
 
 	/* run the evolutionary algorithm */
-	evolve(datafile, generations, max_epochs, desired_error, strategy_max_len,
-			strategy_starting_len, training_sessions, testing_sessions);
+	if ( evolve(&run) == 0 && export_prefix != NULL )
+		export_champion(&run, export_prefix);
 
-	/* remove the population table */
-	hdestroy();
+	free_run(&run);
+	pipe_destroy();
+	destroy_batch_groups();
+	par_destroy();
+	close_corpus(OPTIONS.corpus);
 
 	return 0;
 
@@ -0,0 +1,130 @@
+#ifndef _SURROGATE_C
+#define _SURROGATE_C
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "surrogate.h"
+
+int create_surrogate(struct surrogate_t *s) {
+	const int n = SURROGATE_FEATURES;
+
+	memset(s, 0, sizeof(struct surrogate_t));
+	s->xtx = calloc(n * n, sizeof(double));
+	s->xty = calloc(n, sizeof(double));
+	s->weights = calloc(n, sizeof(double));
+	s->factor = calloc(n * n, sizeof(double));
+	if ( s->xtx == NULL || s->xty == NULL || s->weights == NULL || s->factor == NULL ) {
+		destroy_surrogate(s);
+		return -1;
+	}
+	return 0;
+}
+
+void destroy_surrogate(struct surrogate_t *s) {
+	free(s->xtx);
+	free(s->xty);
+	free(s->weights);
+	free(s->factor);
+	memset(s, 0, sizeof(struct surrogate_t));
+}
+
+/*
+ * the features of a strategy, as the indices of its non-zero ones (a
+ * count appears as many times); returns how many
+ */
+static int features(char *strategy, int *index) {
+	char canonical[strlen(strategy) + 1];
+	int genes, running, i, gene, previous = -1, n = 0;
+
+	canonical_strategy(canonical, strategy);
+	genes = strlen(canonical) / 2;
+	/* only the first half of the genes run, see run_strategy() */
+	running = (genes + 1) / 2;
+
+	index[n++] = 0;
+	for ( i = 0 ; i < genes ; i++ )
+		index[n++] = 1;
+	for ( i = 0 ; i < running ; i++ ) {
+		gene = (canonical[2*i] - 1) * NUM_CONDITIONS + canonical[2*i+1] - 1;
+		index[n++] = 2 + gene;
+		if ( previous >= 0 )
+			index[n++] = 2 + GENE_KINDS + previous * GENE_KINDS + gene;
+		previous = gene;
+	}
+	return n;
+}
+
+void surrogate_observe(struct surrogate_t *s, char *strategy, float value) {
+	int index[2 * strlen(strategy) + 2];
+	int n = features(strategy, index), i, j;
+
+	for ( i = 0 ; i < n ; i++ ) {
+		for ( j = 0 ; j < n ; j++ )
+			s->xtx[index[i] * SURROGATE_FEATURES + index[j]] += 1;
+		s->xty[index[i]] += value;
+	}
+	s->observations++;
+	s->fitted = 0;
+}
+
+int surrogate_ready(struct surrogate_t *s) {
+	return s->observations >= (unsigned long)SURROGATE_MIN_OBSERVATIONS;
+}
+
+/* solve (X'X + ridge) w = X'y by Cholesky; returns -1 if it is singular */
+static int fit(struct surrogate_t *s) {
+	const int n = SURROGATE_FEATURES;
+	double *l = s->factor, *w = s->weights, sum;
+	int i, j, k;
+
+	for ( i = 0 ; i < n ; i++ ) {
+		for ( j = 0 ; j <= i ; j++ ) {
+			sum = s->xtx[i * n + j];
+			if ( i == j && i > 0 )
+				sum += SURROGATE_RIDGE;
+			for ( k = 0 ; k < j ; k++ )
+				sum -= l[i * n + k] * l[j * n + k];
+			if ( i == j ) {
+				if ( sum <= 0 )
+					return -1;
+				l[i * n + i] = sqrt(sum);
+			} else {
+				l[i * n + j] = sum / l[j * n + j];
+			}
+		}
+	}
+
+	/* L z = X'y, then L' w = z */
+	for ( i = 0 ; i < n ; i++ ) {
+		sum = s->xty[i];
+		for ( k = 0 ; k < i ; k++ )
+			sum -= l[i * n + k] * w[k];
+		w[i] = sum / l[i * n + i];
+	}
+	for ( i = n - 1 ; i >= 0 ; i-- ) {
+		sum = w[i];
+		for ( k = i + 1 ; k < n ; k++ )
+			sum -= l[k * n + i] * w[k];
+		w[i] = sum / l[i * n + i];
+	}
+
+	s->fitted = 1;
+	return 0;
+}
+
+/* the predicted rank_value() of a strategy, 0 if there is no model */
+float surrogate_predict(struct surrogate_t *s, char *strategy) {
+	int index[2 * strlen(strategy) + 2];
+	int n, i;
+	double value = 0;
+
+	if ( s->fitted == 0 && fit(s) < 0 )
+		return 0;
+	n = features(strategy, index);
+	for ( i = 0 ; i < n ; i++ )
+		value += s->weights[index[i]];
+	return value;
+}
+
+#endif
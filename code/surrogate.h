@@ -0,0 +1,43 @@
+#ifndef _SURROGATE_H
+#define _SURROGATE_H
+
+#include "scenario.h"
+
+/*
+ * surrogate of the fitness: a ridge regression of rank_value() on the
+ * genes of the strategies evaluated so far, to screen offspring before
+ * paying for their evaluation. With -N the cost of the network is left
+ * out of what it learns: nothing here describes the network.
+ *
+ * The features are those of the canonical form: a bias, the number of
+ * genes, and the counts of every gene and of every pair of consecutive
+ * genes among those that run. Observations only accumulate X'X and X'y;
+ * the weights are solved for again at the first prediction after new
+ * observations.
+ */
+#define GENE_KINDS 12	/* NUM_ACTIONS * NUM_CONDITIONS */
+#define SURROGATE_FEATURES (2 + GENE_KINDS + GENE_KINDS * GENE_KINDS)
+
+/* evaluations before predictions are trusted */
+static const int SURROGATE_MIN_OBSERVATIONS = 20;
+/* ridge penalty, on all the weights but the bias */
+static const double SURROGATE_RIDGE = 0.1;
+/* predicted losers in a row before an offspring is evaluated anyway */
+static const int SURROGATE_MAX_SKIPS = 8;
+
+struct surrogate_t {
+	unsigned long observations;
+	int fitted;		/* 'weights' are up to date */
+	double *xtx;		/* X'X, SURROGATE_FEATURES squared */
+	double *xty;		/* X'y */
+	double *weights;
+	double *factor;		/* scratch: Cholesky factor of X'X + ridge */
+};
+
+int create_surrogate(struct surrogate_t *s);
+void destroy_surrogate(struct surrogate_t *s);
+void surrogate_observe(struct surrogate_t *s, char *strategy, float value);
+int surrogate_ready(struct surrogate_t *s);
+float surrogate_predict(struct surrogate_t *s, char *strategy);
+
+#endif
@@ -0,0 +1,158 @@
+#ifndef _SWEEP_C
+#define _SWEEP_C
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "sweep.h"
+#include "context.h"
+#include "parallel.h"
+
+#define SWEEP_FIELDS 9
+#define SWEEP_VALUES 64		/* values per field */
+#define SWEEP_LINE 1024
+
+/* the values of each field of a line */
+struct sweep_line_t {
+	char *values[SWEEP_FIELDS][SWEEP_VALUES];
+	int num_values[SWEEP_FIELDS];
+};
+
+/* split a line into its fields and their values; returns -1 if malformed */
+static int split_line(char *line, struct sweep_line_t *l) {
+	char *field, *value, *fields_save, *values_save;
+	int f = 0;
+
+	for ( field = strtok_r(line, " \t\n", &fields_save) ; field != NULL 
+			; field = strtok_r(NULL, " \t\n", &fields_save) ) {
+		if ( f == SWEEP_FIELDS )
+			return -1;
+		l->num_values[f] = 0;
+		for ( value = strtok_r(field, ",", &values_save) ; value != NULL 
+				; value = strtok_r(NULL, ",", &values_save) ) {
+			if ( l->num_values[f] == SWEEP_VALUES )
+				return -1;
+			l->values[f][l->num_values[f]++] = value;
+		}
+		f++;
+	}
+	return f == SWEEP_FIELDS ? 0 : -1;
+}
+
+/* the run for combination 'c' of a line, the last field varying fastest */
+static void fill_run(struct run_t *run, struct sweep_line_t *l, long c) {
+	char *v[SWEEP_FIELDS];
+	int f;
+
+	for ( f = SWEEP_FIELDS - 1 ; f >= 0 ; f-- ) {
+		v[f] = l->values[f][c % l->num_values[f]];
+		c /= l->num_values[f];
+	}
+
+	memset(run, 0, sizeof(struct run_t));
+	run->popsize = atoi(v[0]);
+	run->seed = strtol(v[1], NULL, 10);
+	run->generations = atoi(v[2]);
+	run->max_epochs = atoi(v[3]);
+	run->desired_error = atof(v[4]);
+	run->max_len = atoi(v[5]);
+	run->starting_len = atoi(v[6]);
+	run->training_sessions = atoi(v[7]);
+	run->testing_sessions = atoi(v[8]);
+	/* runs share the threads, not the data file */
+	run->datafile = NULL;
+	run->parallel = 0;
+	run->verbose = 0;
+}
+
+/* read the runs of a sweep file; returns their number, -1 on error */
+int read_sweep(char *filename, struct run_t **runs) {
+	char line[SWEEP_LINE], *comment;
+	struct sweep_line_t l;
+	long combinations, c;
+	int n = 0, line_no = 0, f;
+	unsigned int max = 0;
+	FILE *in;
+
+	in = fopen(filename, "r");
+	if ( in == NULL ) {
+		perror("Unable to open sweep file");
+		return -1;
+	}
+
+	*runs = NULL;
+	while ( fgets(line, SWEEP_LINE, in) != NULL ) {
+		line_no++;
+		if ( (comment = strchr(line, '#')) != NULL )
+			*comment = '\0';
+		if ( strspn(line, " \t\n") == strlen(line) )
+			continue;
+
+		if ( split_line(line, &l) < 0 ) {
+			fprintf(stderr, "%s:%d: expected %d fields\n", filename, line_no, SWEEP_FIELDS);
+			goto error;
+		}
+
+		for ( f = 0, combinations = 1 ; f < SWEEP_FIELDS ; f++ )
+			combinations *= l.num_values[f];
+		if ( grow_buffer((void**)runs, &max, n + combinations, sizeof(struct run_t)) < 0 ) {
+			perror("Unable to allocate runs");
+			goto error;
+		}
+		for ( c = 0 ; c < combinations ; c++ )
+			fill_run(&(*runs)[n++], &l, c);
+	}
+
+	fclose(in);
+	return n;
+
+error:
+	fclose(in);
+	free(*runs);
+	*runs = NULL;
+	return -1;
+}
+
+/* par_for() body: one whole run */
+static void sweep_run(void *arg, int item, int worker) {
+	struct run_t *runs = arg;
+
+	if ( evolve(&runs[item]) < 0 )
+		fprintf(stderr, "Run %d did not complete\n", item);
+}
+
+/* 
+ * run them all: each thread of the pool takes the next run as it is
+ * done with the last one
+ */
+void run_sweep(struct run_t *runs, int n) {
+	par_for(n, sweep_run, runs);
+}
+
+void print_sweep(struct run_t *runs, int n) {
+	struct run_t *r;
+	char *gene;
+	int i;
+
+	printf("# run popsize seed generations epochs desired_error max_len starting_len "
+			"training testing error steps length over_budget evaluations trained_epochs seconds best\n");
+	for ( i = 0 ; i < n ; i++ ) {
+		r = &runs[i];
+		printf("%d %lu %u %d %u %g %d %d %d %d ", i, (unsigned long)r->popsize, r->seed, 
+				r->generations, r->max_epochs, r->desired_error, r->max_len, 
+				r->starting_len, r->training_sessions, r->testing_sessions);
+		if ( r->best == NULL ) {
+			printf("- - - - %lu %lu %.3f -\n", r->evaluations, r->epochs, r->seconds);
+			continue;
+		}
+		printf("%f %.1f %d %.2f %lu %lu %.3f ", r->best_fitness.error, r->best_fitness.steps, 
+				r->best_fitness.length, r->best_fitness.over_budget, 
+				r->evaluations, r->epochs, r->seconds);
+		/* the strategy only, print_strategy() needs the run's max length */
+		for ( gene = r->best ; *gene != '\0' ; gene++ )
+			printf("%d", *gene);
+		printf("\n");
+	}
+}
+
+#endif
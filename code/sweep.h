@@ -0,0 +1,24 @@
+#ifndef _SWEEP_H
+#define _SWEEP_H
+
+#include "evolution.h"
+
+/*
+ * parameter sweeps: many runs of the GA in one process.
+ *
+ * A sweep file has one configuration per line, with the positional
+ * arguments of sim but the data file:
+ *   <pop size> <seed> <generations> <max epochs> <desired error>
+ *   <max length> <starting length> <training sessions> <testing sessions>
+ * Any field can be a comma separated list: the line stands for every
+ * combination. '#' starts a comment.
+ *
+ * Runs are spread over the worker pool, one run per thread at a time,
+ * in deterministic mode, training in memory. The results come out as
+ * one table, in the order of the file, whatever the number of threads.
+ */
+int read_sweep(char *filename, struct run_t **runs);
+void run_sweep(struct run_t *runs, int n);
+void print_sweep(struct run_t *runs, int n);
+
+#endif
@@ -0,0 +1,103 @@
+#include <assert.h>
+#include <search.h>
+
+#include "evolution.c"
+#include "scenario.c"
+#include "parallel.c"
+#include "pipeline.c"
+#include "queue.c"
+#include "context.c"
+#include "corpus.c"
+#include "surrogate.c"
+#include "bandit.c"
+#include "trace.c"
+#include "lanes.c"
+#include "bench.c"
+
+/*
+ * runs of the short instance must reach its loosest target: a network
+ * that answers the mean centre is within it. The error of a good
+ * strategy can be below 0 (it starts from -1), which must count as
+ * reached, not as a failed run. Every run, whether it met all its targets or
+ * not, must account for its time and evaluations, and the report must
+ * count the runs that reached each target.
+ */
+int main ( int argc, char **argv ) {
+	const struct instance_t *in = &INSTANCES[0];
+	struct run_t *runs;
+	struct target_t *t;
+	char line[256], name[64];
+	float target;
+	int i, j, seeds, threads, count, reported, reached, failures = 0;
+	FILE *report;
+
+	assert(argc == 3);
+
+	/* first arg is the number of runs, seeds 1 to that */
+	seeds = atoi(argv[1]);
+	assert(seeds > 0 && seeds <= BENCH_MAX_SEEDS);
+	OPTIONS.deterministic = 1;
+
+	/* second arg is the number of threads */
+	threads = atoi(argv[2]);
+	assert(threads > 0);
+
+	runs = calloc(seeds, sizeof(struct run_t));
+	par_init(threads);
+	pipe_init(1, threads, 2);
+	if ( runs == NULL || run_instance(in, runs, seeds, NULL) < 0 ) {
+		printf("FAIL: %s did not run\n", in->name);
+		return -1;
+	}
+
+	for ( i = 0 ; i < seeds ; i++ ) {
+		if ( runs[i].evaluations == 0 || runs[i].seconds <= 0 || runs[i].cpu_seconds <= 0 ) {
+			fprintf(stderr, "Run %d does not account for its effort\n", i);
+			failures++;
+		}
+		if ( runs[i].targets[0].reached == 0 ) {
+			fprintf(stderr, "Run %d missed target %g, best error %f\n", i,
+					runs[i].targets[0].error, runs[i].best_fitness.error);
+			failures++;
+		}
+		for ( j = 0 ; j < runs[i].num_targets ; j++ ) {
+			t = &runs[i].targets[j];
+			if ( t->reached && (t->evaluations > runs[i].evaluations
+						|| t->seconds > runs[i].seconds) ) {
+				fprintf(stderr, "Run %d reached target %g after it ended\n", i, t->error);
+				failures++;
+			}
+		}
+	}
+
+	/* what the report counts */
+	report = tmpfile();
+	assert(report != NULL);
+	report_instance(report, in, runs, seeds);
+	rewind(report);
+	for ( j = 0 ; j < BENCH_NUM_TARGETS && fgets(line, sizeof(line), report) != NULL ; j++ ) {
+		for ( i = 0, reached = 0 ; i < seeds ; i++ )
+			reached += runs[i].targets[j].reached;
+		if ( sscanf(line, "%63s %f %d %d", name, &target, &count, &reported) != 4
+				|| count != seeds || reported != reached ) {
+			fprintf(stderr, "Report line for target %g: %s", BENCH_TARGETS[j], line);
+			failures++;
+		}
+	}
+	if ( j < BENCH_NUM_TARGETS ) {
+		fprintf(stderr, "Report has %d lines of %d\n", j, BENCH_NUM_TARGETS);
+		failures++;
+	}
+	fclose(report);
+
+	pipe_destroy();
+	destroy_batch_groups();
+	par_destroy();
+	for ( i = 0 ; i < seeds ; i++ )
+		free_run(&runs[i]);
+	free(runs);
+
+	printf("%d runs, %d failures\n", seeds, failures);
+	printf("%s\n", failures == 0 ? "PASS" : "FAIL");
+	return failures == 0 ? 0 : -1;
+}
@@ -0,0 +1,135 @@
+#include <assert.h>
+#include <search.h>
+
+#include "evolution.c"
+#include "scenario.c"
+#include "parallel.c"
+#include "pipeline.c"
+#include "queue.c"
+#include "context.c"
+#include "corpus.c"
+#include "surrogate.c"
+#include "bandit.c"
+#include "trace.c"
+#include "lanes.c"
+
+static const char *CORPUS = "testcorpus.corpus";
+
+/* overwrite the first byte of a file; returns -1 on failure */
+static int spoil_magic(const char *filename) {
+	FILE *f = fopen(filename, "r+b");
+	int ok;
+
+	if ( f == NULL )
+		return -1;
+	ok = fputc('X', f) != EOF;
+	return fclose(f) == 0 && ok ? 0 : -1;
+}
+
+/*
+ * a corpus written with -G and read back with -K must give the sessions
+ * its scenarios would have given drawn directly: same objects, and a
+ * strategy run on them gives the same inputs and steps. A truncated
+ * file, or one with another magic, must be refused.
+ */
+int main ( int argc, char **argv ) {
+	struct corpus_t *c;
+	struct scenario_buf_t b;
+	struct scenario_t *direct, *mapped;
+	struct rng_t rng;
+	uint64_t seed, i, count;
+	struct stat st;
+	int j, len, failures = 0;
+
+	assert(argc == 3);
+
+	/* first arg is random seed */
+	seed = strtoull(argv[1], NULL, 10);
+	rng_init(&rng, seed);
+
+	/* second arg is the number of scenarios in the corpus */
+	count = strtoull(argv[2], NULL, 10);
+	assert(count > 1);
+
+	STRATEGY_MAX_LENGTH = 41;
+
+	if ( write_corpus((char *)CORPUS, count, seed) < 0
+			|| (c = open_corpus((char *)CORPUS)) == NULL ) {
+		printf("FAIL: corpus not written or not read back\n");
+		return -1;
+	}
+	if ( c->count != count ) {
+		printf("FAIL: %lu scenarios read back, %lu written\n",
+				(unsigned long)c->count, (unsigned long)count);
+		return -1;
+	}
+
+	for ( i = 0 ; i < count ; i++ ) {
+		char *strategy = gen_strategy(2 + rng_next32(&rng) % (STRATEGY_MAX_LENGTH - 3), &rng);
+		struct program_t *program = compile_strategy(strategy);
+		struct rng_t scenario_rng;
+
+		len = get_input_neurones(strategy);
+		fann_type generated[len], read[len];
+		struct condition_t now[program->num_actions];
+
+		rng_init(&scenario_rng, rng_key(seed, i));
+		direct = gen_scenario_rng(&scenario_rng);
+		mapped = corpus_scenario(&b, c, i);
+
+		if ( memcmp(direct->obj1, mapped->obj1, sizeof(struct object_t)) != 0
+				|| memcmp(direct->obj2, mapped->obj2, sizeof(struct object_t)) != 0
+				|| direct->nearest_object_centre != mapped->nearest_object_centre ) {
+			fprintf(stderr, "Scenario %lu differs\n", (unsigned long)i);
+			failures++;
+		}
+
+		run_program_mem(program, direct, generated, len, now);
+		run_program_mem(program, mapped, read, len, now);
+		for ( j = 0 ; j < len ; j++ )
+			if ( memcmp(&generated[j], &read[j], sizeof(fann_type)) != 0 )
+				break;
+		if ( j < len || direct->sensor->pos != mapped->sensor->pos
+				|| direct->sensor->lateral_steps != mapped->sensor->lateral_steps
+				|| direct->sensor->angular_steps != mapped->sensor->angular_steps
+				|| direct->sensor->outcome != mapped->sensor->outcome ) {
+			fprintf(stderr, "Session on scenario %lu differs at input %d: ", (unsigned long)i, j);
+			print_strategy(strategy);
+			failures++;
+		}
+
+		destroy_scenario(direct);
+		destroy_program(program);
+		free(strategy);
+	}
+	close_corpus(c);
+
+	/* the last record cut short */
+	if ( stat(CORPUS, &st) < 0 || truncate(CORPUS, st.st_size - 1) < 0 ) {
+		perror("Unable to truncate corpus");
+		return -1;
+	}
+	c = open_corpus((char *)CORPUS);
+	if ( c != NULL ) {
+		fprintf(stderr, "Truncated corpus accepted\n");
+		close_corpus(c);
+		failures++;
+	}
+
+	/* whole, but not a corpus */
+	if ( write_corpus((char *)CORPUS, count, seed) < 0 || spoil_magic(CORPUS) < 0 ) {
+		perror("Unable to spoil corpus");
+		return -1;
+	}
+	c = open_corpus((char *)CORPUS);
+	if ( c != NULL ) {
+		fprintf(stderr, "Corpus with another magic accepted\n");
+		close_corpus(c);
+		failures++;
+	}
+	remove(CORPUS);
+
+	printf("%lu scenarios, %d mismatches\n", (unsigned long)count, failures);
+	printf("%s\n", failures == 0 ? "PASS" : "FAIL");
+	return failures == 0 ? 0 : -1;
+}
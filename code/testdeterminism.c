@@ -0,0 +1,151 @@
+#include <assert.h>
+#include <search.h>
+
+#include "evolution.c"
+#include "scenario.c"
+#include "parallel.c"
+#include "pipeline.c"
+#include "queue.c"
+#include "context.c"
+#include "corpus.c"
+#include "surrogate.c"
+#include "bandit.c"
+#include "trace.c"
+#include "lanes.c"
+
+static const int STRATEGIES = 8;
+/* data-parallel training: enough sessions for several shards */
+static const int SHARDED_STRATEGIES = 3;
+static const int SHARDED_SESSIONS = 300;
+/* lanes train as FANN does, not with the same sums: how far the mean
+ * error of a network trained in lanes may land from FANN's */
+static const double LANED_TOLERANCE = 0.001;
+
+/* mean error over the testing sessions */
+static double mean_error(struct run_t *run, struct fitness_t *fitness) {
+	return fitness->error + 1.0 / run->testing_sessions;
+}
+
+/*
+ * self-check for deterministic mode: the same evaluations run with one
+ * thread, with many, and through the pipeline must give bit for bit
+ * the same fitness. So must lane-batched training, whatever the other
+ * networks in the lanes, and it must land near training with FANN
+ */
+int main ( int argc, char **argv ) {
+	int i, threads, failures = 0;
+	char *strategies[STRATEGIES];
+	struct fitness_t single[STRATEGIES], multi[STRATEGIES], piped[STRATEGIES];
+	struct fitness_t laned[STRATEGIES], laned_single[STRATEGIES];
+	struct lanes_t lanes;
+	unsigned long id;
+	struct fitness_t sharded_single[SHARDED_STRATEGIES], sharded_multi[SHARDED_STRATEGIES];
+	struct rng_t rng;
+	struct eval_ctx_t *ctx;
+	struct run_t run;
+
+	assert(argc == 3);
+
+	/* first arg is random seed */
+	memset(&run, 0, sizeof(struct run_t));
+	run.seed = strtol(argv[1], NULL, 10);
+	run.parallel = 1;
+	OPTIONS.deterministic = 1;
+
+	/* second arg is the number of threads to compare against */
+	threads = atoi(argv[2]);
+	assert(threads > 1);
+
+	run.max_epochs = 200;
+	run.desired_error = 0.0001;
+	STRATEGY_MAX_LENGTH = 21;
+	run.training_sessions = 50;
+	run.testing_sessions = 100;
+
+	rng_init(&rng, rng_key(run.seed, KEY_BREEDING));
+	for ( i = 0 ; i < STRATEGIES ; i++ )
+		strategies[i] = gen_strategy(2 + 2 * i, &rng);
+
+	/* single thread run, one context reused throughout */
+	par_init(1);
+	ctx = create_context();
+	for ( i = 0 ; i < STRATEGIES ; i++ )
+		single[i] = eval(&run, ctx, strategies[i], i);
+	destroy_context(ctx);
+
+	/* multithreaded run, evaluated in reverse order on purpose,
+	 * with a new context every time */
+	par_init(threads);
+	for ( i = STRATEGIES - 1 ; i >= 0 ; i-- ) {
+		ctx = create_context();
+		multi[i] = eval(&run, ctx, strategies[i], i);
+		destroy_context(ctx);
+	}
+	par_destroy();
+
+	/* pipelined batch run */
+	pipe_init(2, threads, 2);
+	eval_batch(&run, strategies, STRATEGIES, 0, piped, NULL, NULL);
+
+	/* lane-batched training: through the pipeline, then one lane at a
+	 * time, padded to other widths or not at all */
+	OPTIONS.lanes = 1;
+	eval_batch(&run, strategies, STRATEGIES, 0, laned, NULL, NULL);
+	pipe_destroy();
+	destroy_batch_groups();
+	par_init(1);
+	memset(&lanes, 0, sizeof(struct lanes_t));
+	ctx = create_context();
+	for ( i = 0 ; i < STRATEGIES ; i++ ) {
+		id = i;
+		eval_lanes(&run, &ctx, &lanes, &strategies[i], &id, 1, &laned_single[i]);
+	}
+	destroy_context(ctx);
+	free_lanes(&lanes);
+	OPTIONS.lanes = 0;
+
+	/* data-parallel training, on one thread and on many */
+	OPTIONS.sharded_training = 1;
+	run.training_sessions = SHARDED_SESSIONS;
+	par_init(1);
+	ctx = create_context();
+	for ( i = 0 ; i < SHARDED_STRATEGIES ; i++ )
+		sharded_single[i] = eval(&run, ctx, strategies[i], i);
+	destroy_context(ctx);
+	par_init(threads);
+	ctx = create_context();
+	for ( i = 0 ; i < SHARDED_STRATEGIES ; i++ )
+		sharded_multi[i] = eval(&run, ctx, strategies[i], i);
+	destroy_context(ctx);
+	par_destroy();
+
+	for ( i = 0 ; i < SHARDED_STRATEGIES ; i++ ) {
+		printf("sharded %f %f\n", sharded_single[i].error, sharded_multi[i].error);
+		if ( memcmp(&sharded_single[i], &sharded_multi[i], sizeof(struct fitness_t)) != 0 ) {
+			fprintf(stderr, "Mismatch on sharded strategy %d\n", i);
+			failures++;
+		}
+	}
+
+	for ( i = 0 ; i < STRATEGIES ; i++ ) {
+		printf("%f %f %f %f %f ", single[i].error, multi[i].error, piped[i].error, 
+				laned[i].error, laned_single[i].error);
+		print_strategy(strategies[i]);
+		if ( memcmp(&single[i], &multi[i], sizeof(struct fitness_t)) != 0 
+				|| memcmp(&single[i], &piped[i], sizeof(struct fitness_t)) != 0 
+				|| memcmp(&laned[i], &laned_single[i], sizeof(struct fitness_t)) != 0 ) {
+			fprintf(stderr, "Mismatch on strategy %d\n", i);
+			failures++;
+		}
+		/* the error starts from -1: compare the means */
+		if ( fabs(mean_error(&run, &laned[i]) - mean_error(&run, &single[i])) > LANED_TOLERANCE ) {
+			fprintf(stderr, "Lane training of strategy %d is off FANN's by %f\n", i, 
+					fabs(mean_error(&run, &laned[i]) - mean_error(&run, &single[i])));
+			failures++;
+		}
+		free(strategies[i]);
+	}
+
+	printf("%s\n", failures == 0 ? "PASS" : "FAIL");
+	return failures == 0 ? 0 : -1;
+}
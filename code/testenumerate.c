@@ -0,0 +1,161 @@
+#include <assert.h>
+#include <search.h>
+#include <sys/time.h>
+
+#include "evolution.c"
+#include "scenario.c"
+#include "parallel.c"
+#include "pipeline.c"
+#include "queue.c"
+#include "context.c"
+#include "corpus.c"
+#include "surrogate.c"
+#include "bandit.c"
+#include "trace.c"
+#include "lanes.c"
+#include "enumerate.c"
+
+static const int THREADS = 4;
+/* interrupts tried, each sooner than the one before */
+static const int ATTEMPTS = 6;
+
+static const char *FULL_TABLE = "testenumerate.full";
+static const char *RESUMED_TABLE = "testenumerate.resumed";
+static const char *CHECKPOINT = "testenumerate.checkpoint";
+
+static void interrupt(int sig) {
+	keep_going = 0;
+}
+
+static double wall_seconds() {
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+/* strategies the checkpoint has evaluated, -1 if it cannot be read */
+static long checkpoint_done(const char *filename) {
+	struct checkpoint_header_t h;
+	unsigned long i;
+	long done = 0;
+	FILE *f;
+	int c;
+
+	f = fopen(filename, "rb");
+	if ( f == NULL )
+		return -1;
+	if ( fread(&h, sizeof(h), 1, f) != 1 ) {
+		fclose(f);
+		return -1;
+	}
+	for ( i = 0 ; i < h.total && (c = fgetc(f)) != EOF ; i++ )
+		done += c;
+	fclose(f);
+	return i == h.total ? done : -1;
+}
+
+/* 1 if the files hold the same bytes */
+static int same_files(const char *a, const char *b) {
+	FILE *fa = fopen(a, "rb"), *fb = fopen(b, "rb");
+	int ca, cb, same = fa != NULL && fb != NULL;
+
+	while ( same ) {
+		ca = fgetc(fa);
+		cb = fgetc(fb);
+		same = ca == cb;
+		if ( ca == EOF )
+			break;
+	}
+	if ( fa != NULL )
+		fclose(fa);
+	if ( fb != NULL )
+		fclose(fb);
+	return same;
+}
+
+/*
+ * an enumeration interrupted part way (the way SIGINT does it) then
+ * resumed from its checkpoint must rank the strategies exactly as one
+ * run straight through
+ */
+int main ( int argc, char **argv ) {
+	struct itimerval timer;
+	struct run_t run;
+	double seconds, delay;
+	long done = 0, total;
+	int genes, attempt;
+
+	assert(argc == 3);
+
+	/* first arg is random seed */
+	memset(&run, 0, sizeof(struct run_t));
+	run.seed = strtol(argv[1], NULL, 10);
+	run.parallel = 0;
+	OPTIONS.deterministic = 1;
+
+	/* second arg is the number of genes to enumerate up to */
+	genes = atoi(argv[2]);
+	assert(genes >= 2 && genes <= MAX_ENUM_GENES);
+
+	run.max_epochs = 50;
+	run.desired_error = 0.0001;
+	run.training_sessions = 20;
+	run.testing_sessions = 50;
+	par_init(THREADS);
+
+	/* 12 + 12^2 + ... + 12^genes */
+	for ( total = 0, attempt = 1 ; attempt <= genes ; attempt++ )
+		total = total * GENE_OPTIONS + GENE_OPTIONS;
+
+	/* straight through */
+	seconds = wall_seconds();
+	if ( enumerate(&run, genes, (char *)FULL_TABLE, NULL) < 0 ) {
+		printf("FAIL: enumeration\n");
+		return -1;
+	}
+	seconds = wall_seconds() - seconds;
+
+	/* interrupted, sooner and sooner until it stops before the end */
+	signal(SIGALRM, interrupt);
+	for ( attempt = 0, delay = seconds / 2 ; attempt < ATTEMPTS ; attempt++, delay /= 4 ) {
+		remove(CHECKPOINT);
+		memset(&timer, 0, sizeof(timer));
+		timer.it_value.tv_sec = (long)delay;
+		timer.it_value.tv_usec = (long)((delay - (long)delay) * 1e6) + 1;
+		setitimer(ITIMER_REAL, &timer, NULL);
+		enumerate(&run, genes, (char *)RESUMED_TABLE, (char *)CHECKPOINT);
+		memset(&timer, 0, sizeof(timer));
+		setitimer(ITIMER_REAL, &timer, NULL);
+
+		done = checkpoint_done(CHECKPOINT);
+		if ( done >= 0 && done < total )
+			break;
+	}
+	signal(SIGALRM, SIG_DFL);
+
+	printf("interrupted after %ld of %ld strategies\n", done, total);
+	if ( done < 0 || done >= total ) {
+		printf("FAIL: the enumeration was never interrupted\n");
+		return -1;
+	}
+
+	/* resumed */
+	if ( enumerate(&run, genes, (char *)RESUMED_TABLE, (char *)CHECKPOINT) < 0
+			|| checkpoint_done(CHECKPOINT) != total ) {
+		printf("FAIL: resumed enumeration\n");
+		return -1;
+	}
+	par_destroy();
+
+	if ( !same_files(FULL_TABLE, RESUMED_TABLE) ) {
+		printf("FAIL: %s and %s differ\n", FULL_TABLE, RESUMED_TABLE);
+		return -1;
+	}
+
+	remove(FULL_TABLE);
+	remove(RESUMED_TABLE);
+	remove(CHECKPOINT);
+	printf("PASS\n");
+	return 0;
+}
@@ -3,10 +3,19 @@
 
 #include "evolution.c"
 #include "scenario.c"
+#include "parallel.c"
+#include "pipeline.c"
+#include "queue.c"
+#include "context.c"
+#include "corpus.c"
+#include "surrogate.c"
+#include "bandit.c"
+#include "trace.c"
+#include "lanes.c"
 
 int main ( int argc, char **argv ) {
 	int i, MAX_POPSIZE;
-	ENTRY item1, item2;
+	struct population_t population;
 
 	assert(argc == 3);
 
@@ -17,15 +26,18 @@ int main ( int argc, char **argv ) {
 	/* second arg is max population size */
 	MAX_POPSIZE = atoi(argv[2]);
 
+	/* as evolve() sets it for its run: odd, the last byte is \0 */
+	STRATEGY_MAX_LENGTH = 17;
+
 	/* initialise population */
-	if ( hcreate(MAX_POPSIZE) == 0 ) {
+	if ( create_population(&population, MAX_POPSIZE) < 0 ) {
 		perror("Unable to allocate population");
 		return -1;
 	}
 
 	/* testing strategy generation */
-	char* strategy1 = gen_strategy();
-	char* strategy2 = gen_strategy();
+	char* strategy1 = gen_strategy(STRATEGY_MAX_LENGTH, NULL);
+	char* strategy2 = gen_strategy(STRATEGY_MAX_LENGTH, NULL);
 	for ( i = 0 ; i < STRATEGY_MAX_LENGTH ; i++ )
 		printf("%d", strategy1[i]);
 	printf("\n");
@@ -34,15 +46,13 @@ int main ( int argc, char **argv ) {
 	printf("\n\n");
 
 	/* put strategies in population */
-	item1.key = strdup(strategy1);
-	item2.key = strdup(strategy2);
-	if ( hsearch(item1, ENTER) == NULL 
-			|| hsearch(item2, ENTER) == NULL ) {
+	if ( add_strategy(&population, strategy1, NULL) < 0 
+			|| add_strategy(&population, strategy2, NULL) < 0 ) {
 		perror("Population limit reached");
 		return -1;
 	}
 
-	while ( mutate_breed(strategy1, strategy2) >= 0 ) {
+	while ( breed(&population, strategy1, NULL, strategy2, NULL, NULL, NULL) >= 0 ) {
 		for ( i = 0 ; i < STRATEGY_MAX_LENGTH ; i++ )
 			printf("%d", strategy1[i]);
 		printf("\n");
@@ -61,7 +71,7 @@ int main ( int argc, char **argv ) {
 	free(strategy1); 
 	free(strategy2); 
 
-	hdestroy();
+	destroy_population(&population);
 
 	return 0;
 }
@@ -0,0 +1,142 @@
+#include <assert.h>
+#include <search.h>
+
+#include "evolution.c"
+#include "scenario.c"
+#include "parallel.c"
+#include "pipeline.c"
+#include "queue.c"
+#include "context.c"
+#include "corpus.c"
+#include "surrogate.c"
+#include "bandit.c"
+#include "trace.c"
+#include "lanes.c"
+#include "export.c"
+
+/*
+ * how far the output of the fixed-point network may be from the float
+ * one, for networks whose output weights leave the output layer at
+ * least MIN_OUTPUT_FRAC fractional bits: larger output weights magnify
+ * the rounding of the hidden layer past any fixed bound
+ */
+static const double FIXED_BOUND = 0.05;
+static const int MIN_OUTPUT_FRAC = 10;
+
+/*
+ * networks trained on the scenarios, quantised, must give the output of
+ * the float network within the bound on scenarios they were neither
+ * trained nor quantised on. Zeroing the weights of the inputs no gene
+ * senses into must not change a single output. Every other network has
+ * Elliot hidden neurons. Networks with a weight too
+ * large for 16 bits, or an activation without a table, must be refused.
+ */
+int main ( int argc, char **argv ) {
+	int i, runs, checked = 0, failures = 0;
+	struct rng_t rng;
+	struct eval_ctx_t *ctx, *bank;
+	struct run_t run;
+	struct topology_t topology;
+	struct fixed_net_t q;
+	struct fixed_check_t check;
+	struct fann *ann;
+	char *strategy;
+	int j;
+
+	assert(argc == 3);
+
+	/* first arg is random seed */
+	memset(&run, 0, sizeof(struct run_t));
+	run.seed = strtol(argv[1], NULL, 10);
+	run.parallel = 1;
+	OPTIONS.deterministic = 1;
+
+	/* second arg is the number of networks to check */
+	runs = atoi(argv[2]);
+
+	run.max_epochs = 200;
+	run.desired_error = 0.0001;
+	STRATEGY_MAX_LENGTH = 21;
+	run.training_sessions = 50;
+	run.testing_sessions = 100;
+
+	rng_init(&rng, rng_key(run.seed, KEY_BREEDING));
+	par_init(1);
+	ctx = create_context();
+	bank = create_context();
+
+	for ( i = 0 ; i < runs ; i++ ) {
+		strategy = gen_strategy(2 + rng_next32(&rng) % (STRATEGY_MAX_LENGTH - 3), &rng);
+		topology.hidden = get_input_neurones(strategy) + 5;
+		topology.activation = i % 2 ? ACT_ELLIOT : ACT_SIGMOID_STEPWISE;
+		ctx->topology = &topology;
+		eval(&run, ctx, strategy, i);
+		ctx->topology = NULL;
+
+		/* scenarios of its own, keyed apart from every evaluation */
+		simulate(&run, bank, strategy, rng_key(run.seed, runs + i), 1, 0);
+
+		ann = fann_copy(ctx->ann);
+		drop_idle_inputs(ctx->ann);
+		for ( j = 0 ; j < run.testing_sessions ; j++ )
+			if ( fann_run(ann, bank->testing_inputs[j])[0] 
+					!= fann_run(ctx->ann, bank->testing_inputs[j])[0] )
+				break;
+		if ( j < run.testing_sessions ) {
+			fprintf(stderr, "Dropping idle inputs changed network %d\n", i);
+			failures++;
+		}
+		fann_destroy(ann);
+
+		if ( quantise_network(&q, ctx->ann, input_frac(ctx, run.testing_sessions)) < 0 ) {
+			fprintf(stderr, "Unable to quantise the network of ");
+			print_strategy(strategy);
+			failures++;
+			free(strategy);
+			continue;
+		}
+		check_fixed(ctx->ann, bank, &q, run.testing_sessions, &check);
+		printf("%f %f %f %f ", check.max_diff, check.mean_diff, check.float_error, check.fixed_error);
+		print_strategy(strategy);
+		if ( q.output_frac >= MIN_OUTPUT_FRAC ) {
+			checked++;
+			if ( check.max_diff > FIXED_BOUND ) {
+				fprintf(stderr, "Fixed-point network %d is off by %f\n", i, check.max_diff);
+				failures++;
+			}
+		}
+		free_fixed_net(&q);
+
+		/* a weight that fits no format */
+		ann = fann_copy(ctx->ann);
+		ann->weights[i % ann->total_connections] = 1e6;
+		if ( quantise_network(&q, ann, 8) == 0 ) {
+			fprintf(stderr, "Weight out of range accepted in network %d\n", i);
+			failures++;
+		}
+		free_fixed_net(&q);
+		fann_destroy(ann);
+
+		/* an activation without a table */
+		ann = fann_copy(ctx->ann);
+		fann_set_activation_function_output(ann, FANN_LINEAR);
+		if ( quantise_network(&q, ann, 8) == 0 ) {
+			fprintf(stderr, "Linear output accepted in network %d\n", i);
+			failures++;
+		}
+		free_fixed_net(&q);
+		fann_destroy(ann);
+
+		free(strategy);
+	}
+
+	destroy_context(bank);
+	destroy_context(ctx);
+	if ( runs > 0 && checked == 0 ) {
+		fprintf(stderr, "No network fine enough to check\n");
+		failures++;
+	}
+	printf("%d networks, %d within bound checked, %d failures\n", runs, checked, failures);
+	printf("%s\n", failures == 0 ? "PASS" : "FAIL");
+	return failures == 0 ? 0 : -1;
+}
@@ -0,0 +1,99 @@
+#include <assert.h>
+#include <search.h>
+
+#include "evolution.c"
+#include "scenario.c"
+#include "parallel.c"
+#include "pipeline.c"
+#include "queue.c"
+#include "context.c"
+#include "corpus.c"
+#include "surrogate.c"
+#include "bandit.c"
+#include "trace.c"
+#include "lanes.c"
+
+/*
+ * compiled strategies must behave exactly as the interpreter:
+ * same inputs for the network, same final sensor position, same steps
+ * and budgets run out. So must their canonical form.
+ * Every other strategy runs under step budgets, which stop the run.
+ */
+int main ( int argc, char **argv ) {
+	int i, j, len, runs, failures = 0, out_of_budget = 0;
+	struct rng_t rng, scenario_rng;
+
+	assert(argc == 3);
+
+	/* first arg is random seed */
+	rng_init(&rng, strtol(argv[1], NULL, 10));
+
+	/* second arg is the number of strategies to check */
+	runs = atoi(argv[2]);
+
+	STRATEGY_MAX_LENGTH = 41;
+
+	for ( i = 0 ; i < runs ; i++ ) {
+		char *strategy = gen_strategy(2 + rng_next32(&rng) % (STRATEGY_MAX_LENGTH - 3), &rng);
+		struct program_t *program = compile_strategy(strategy);
+		struct scenario_t *s1, *s2, *s3;
+		uint64_t key = rng_next32(&rng);
+
+		len = get_input_neurones(strategy);
+		fann_type interpreted[len], compiled[len], canonical[len];
+		char normal[strlen(strategy) + 1];
+		struct condition_t now[program->num_actions];
+
+		BUDGET.action_steps = i % 2 ? 20 : 0;
+		BUDGET.strategy_steps = i % 2 ? 60 : 0;
+
+		rng_init(&scenario_rng, key);
+		s1 = gen_scenario_rng(&scenario_rng);
+		rng_init(&scenario_rng, key);
+		s2 = gen_scenario_rng(&scenario_rng);
+		rng_init(&scenario_rng, key);
+		s3 = gen_scenario_rng(&scenario_rng);
+
+		run_strategy_mem(strategy, s1, interpreted, len);
+		run_program_mem(program, s2, compiled, len, now);
+		canonical_strategy(normal, strategy);
+		run_strategy_mem(normal, s3, canonical, len);
+
+		for ( j = 0 ; j < len ; j++ )
+			if ( memcmp(&interpreted[j], &compiled[j], sizeof(fann_type)) != 0 )
+				break;
+		if ( j < len || s1->sensor->pos != s2->sensor->pos 
+				|| s1->sensor->angle != s2->sensor->angle 
+				|| s1->sensor->lateral_steps != s2->sensor->lateral_steps 
+				|| s1->sensor->angular_steps != s2->sensor->angular_steps 
+				|| s1->sensor->outcome != s2->sensor->outcome ) {
+			fprintf(stderr, "Mismatch at input %d: ", j);
+			print_strategy(strategy);
+			failures++;
+		}
+
+		for ( j = 0 ; j < len ; j++ )
+			if ( memcmp(&interpreted[j], &canonical[j], sizeof(fann_type)) != 0 )
+				break;
+		if ( j < len || s1->sensor->lateral_steps != s3->sensor->lateral_steps 
+				|| s1->sensor->angular_steps != s3->sensor->angular_steps 
+				|| s1->sensor->outcome != s3->sensor->outcome ) {
+			fprintf(stderr, "Canonical form differs at input %d: ", j);
+			print_strategy(strategy);
+			failures++;
+		}
+
+		if ( s1->sensor->outcome != 0 )
+			out_of_budget++;
+
+		destroy_scenario(s1);
+		destroy_scenario(s2);
+		destroy_scenario(s3);
+		destroy_program(program);
+		free(strategy);
+	}
+
+	printf("%d strategies, %d out of budget, %d mismatches\n", runs, out_of_budget, failures);
+	printf("%s\n", failures == 0 ? "PASS" : "FAIL");
+	return failures == 0 ? 0 : -1;
+}
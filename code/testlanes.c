@@ -0,0 +1,100 @@
+#include <assert.h>
+#include <search.h>
+
+#include "evolution.c"
+#include "scenario.c"
+#include "parallel.c"
+#include "pipeline.c"
+#include "queue.c"
+#include "context.c"
+#include "corpus.c"
+#include "surrogate.c"
+#include "bandit.c"
+#include "trace.c"
+#include "lanes.c"
+
+/* how far the mean error of a network trained in lanes may land from FANN's */
+static const double LANED_TOLERANCE = 0.001;
+
+/* mean error over the testing sessions */
+static double mean_error(struct run_t *run, struct fitness_t *fitness) {
+	return fitness->error + 1.0 / run->testing_sessions;
+}
+
+/*
+ * lane-batched training against FANN, on the same simulated sessions:
+ * LANES networks trained one by one with score(), then together with
+ * score_lanes(), for as many batches as asked. Prints the CPU time of
+ * each and the speedup, which depends on the machine and on the width
+ * of the lanes it was built for: it is measured, not checked. The mean
+ * errors must agree within the tolerance.
+ */
+int main ( int argc, char **argv ) {
+	struct eval_ctx_t *ctx[LANES];
+	struct fitness_t single[LANES], laned[LANES];
+	struct lanes_t lanes;
+	struct rng_t rng;
+	struct run_t run;
+	char *strategies[LANES];
+	double started, single_seconds = 0, laned_seconds = 0;
+	int i, b, batches, failures = 0;
+
+	assert(argc == 3);
+
+	/* first arg is random seed */
+	memset(&run, 0, sizeof(struct run_t));
+	run.seed = strtol(argv[1], NULL, 10);
+	OPTIONS.deterministic = 1;
+
+	/* second arg is the number of batches */
+	batches = atoi(argv[2]);
+
+	run.max_epochs = 200;
+	run.desired_error = 0.0001;
+	STRATEGY_MAX_LENGTH = 21;
+	run.training_sessions = 50;
+	run.testing_sessions = 100;
+
+	rng_init(&rng, rng_key(run.seed, KEY_BREEDING));
+	par_init(1);
+	memset(&lanes, 0, sizeof(struct lanes_t));
+	for ( i = 0 ; i < LANES ; i++ )
+		ctx[i] = create_context();
+
+	for ( b = 0 ; b < batches ; b++ ) {
+		for ( i = 0 ; i < LANES ; i++ ) {
+			strategies[i] = gen_strategy(2 + rng_next32(&rng) % (STRATEGY_MAX_LENGTH - 3), &rng);
+			simulate(&run, ctx[i], strategies[i], rng_key(run.seed, b * LANES + i), 1, 0);
+		}
+
+		started = cpu_seconds();
+		for ( i = 0 ; i < LANES ; i++ )
+			single[i] = score(&run, ctx[i], NULL);
+		single_seconds += cpu_seconds() - started;
+
+		started = cpu_seconds();
+		score_lanes(&run, &lanes, ctx, LANES, laned);
+		laned_seconds += cpu_seconds() - started;
+
+		for ( i = 0 ; i < LANES ; i++ ) {
+			if ( single[i].failed || laned[i].failed || fabs(mean_error(&run, &laned[i])
+						- mean_error(&run, &single[i])) > LANED_TOLERANCE ) {
+				fprintf(stderr, "Lane training is off FANN's on ");
+				print_strategy(strategies[i]);
+				failures++;
+			}
+			free(strategies[i]);
+		}
+	}
+
+	for ( i = 0 ; i < LANES ; i++ )
+		destroy_context(ctx[i]);
+	free_lanes(&lanes);
+	par_destroy();
+
+	printf("%d networks, %d lanes: FANN %.3f s, lanes %.3f s, speedup %.2f\n", batches * LANES,
+			LANES, single_seconds, laned_seconds,
+			laned_seconds > 0 ? single_seconds / laned_seconds : 0);
+	printf("%s\n", failures == 0 ? "PASS" : "FAIL");
+	return failures == 0 ? 0 : -1;
+}
@@ -4,6 +4,15 @@
 
 #include "scenario.c"
 #include "evolution.c"
+#include "parallel.c"
+#include "pipeline.c"
+#include "queue.c"
+#include "context.c"
+#include "corpus.c"
+#include "surrogate.c"
+#include "bandit.c"
+#include "trace.c"
+#include "lanes.c"
 
 static const int CONDS = 10;
 
@@ -57,7 +66,7 @@ int main ( int argc, char **argv ) {
 	/* strategy */ 
 	//char strategy[STRATEGY_MAX_LENGTH];
 	//gen_strategy(strategy, STRATEGY_MAX_LENGTH);
-	char *strategy = gen_strategy();
+	char *strategy = gen_strategy(STRATEGY_MAX_LENGTH, NULL);
 	/*
 	strategy[0] = ROTATE_RIGHT;
 	strategy[1] = OBJECT;
@@ -0,0 +1,174 @@
+#ifndef _TRACE_C
+#define _TRACE_C
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include "trace.h"
+
+volatile int TRACING = 0;
+__thread struct trace_ring_t *TRACE_RING = NULL;
+
+/* every thread's ring, to be dumped */
+static pthread_mutex_t rings_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct trace_ring_t *rings[TRACE_MAX_THREADS];
+static volatile int num_rings = 0;
+/* where the rings are dumped: no allocation from a signal handler */
+static char trace_file[4096];
+
+static const int CRASH_SIGNALS[] = { SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT };
+#define NUM_CRASH_SIGNALS (int)(sizeof(CRASH_SIGNALS) / sizeof(CRASH_SIGNALS[0]))
+
+/* the ring of this thread, allocated at its first event; NULL if none is left */
+struct trace_ring_t *trace_ring() {
+	static __thread int failed = 0;
+	struct trace_ring_t *r;
+
+	if ( failed )
+		return NULL;
+	r = malloc(sizeof(struct trace_ring_t));
+	pthread_mutex_lock(&rings_lock);
+	if ( r == NULL || num_rings == TRACE_MAX_THREADS ) {
+		pthread_mutex_unlock(&rings_lock);
+		free(r);
+		failed = 1;
+		return NULL;
+	}
+	r->head = 0;
+	r->thread = num_rings;
+	rings[num_rings] = r;
+	num_rings++;
+	pthread_mutex_unlock(&rings_lock);
+
+	TRACE_RING = r;
+	return r;
+}
+
+/* write(2) it all, or fail */
+static int write_all(int fd, const void *buf, size_t len) {
+	const char *p = buf;
+	ssize_t n;
+
+	while ( len > 0 ) {
+		n = write(fd, p, len);
+		if ( n < 0 && errno == EINTR )
+			continue;
+		if ( n <= 0 )
+			return -1;
+		p += n;
+		len -= n;
+	}
+	return 0;
+}
+
+/*
+ * dump every ring into the trace file, replacing it; safe in a signal
+ * handler (no stdio, no allocation). Returns -1 on failure.
+ */
+int trace_dump() {
+	struct trace_header_t h;
+	struct trace_ring_header_t rh;
+	struct trace_ring_t *r;
+	uint64_t first;
+	int fd, i, n = num_rings, ret = 0;
+
+	if ( trace_file[0] == '\0' )
+		return -1;
+	fd = open(trace_file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if ( fd < 0 )
+		return -1;
+
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, TRACE_MAGIC, sizeof(h.magic));
+	h.version = TRACE_VERSION;
+	h.event_size = sizeof(struct trace_event_t);
+#if defined(__x86_64__) || defined(__i386__)
+	h.tsc = 1;
+#endif
+	h.rings = n;
+	ret |= write_all(fd, &h, sizeof(h));
+
+	for ( i = 0 ; i < n ; i++ ) {
+		r = rings[i];
+		rh.thread = r->thread;
+		rh.recorded = r->head;
+		rh.count = rh.recorded < TRACE_EVENTS ? rh.recorded : TRACE_EVENTS;
+		ret |= write_all(fd, &rh, sizeof(rh));
+
+		/* oldest first: from the head when the ring has wrapped */
+		first = (rh.recorded - rh.count) & (TRACE_EVENTS - 1);
+		ret |= write_all(fd, &r->events[first], 
+				sizeof(struct trace_event_t) * (rh.count < TRACE_EVENTS - first 
+					? rh.count : TRACE_EVENTS - first));
+		if ( rh.count > TRACE_EVENTS - first )
+			ret |= write_all(fd, r->events, 
+					sizeof(struct trace_event_t) * (rh.count - (TRACE_EVENTS - first)));
+	}
+
+	close(fd);
+	return ret;
+}
+
+static void dump_on_signal(int sig) {
+	trace_dump();
+}
+
+static void toggle_on_signal(int sig) {
+	TRACING = !TRACING;
+}
+
+/* dump what led to the crash, then crash as if there were no handler */
+static void dump_on_crash(int sig) {
+	TRACING = 0;
+	trace_dump();
+	signal(sig, SIG_DFL);
+	raise(sig);
+}
+
+/*
+ * start tracing into 'filename', with the signal handlers; returns -1
+ * if the file name is too long
+ */
+int trace_open(char *filename) {
+	struct sigaction sa;
+	int i;
+
+	if ( strlen(filename) >= sizeof(trace_file) )
+		return -1;
+	strcpy(trace_file, filename);
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_flags = SA_RESTART;
+	sa.sa_handler = dump_on_signal;
+	sigaction(SIGUSR1, &sa, NULL);
+	sa.sa_handler = toggle_on_signal;
+	sigaction(SIGUSR2, &sa, NULL);
+	sa.sa_handler = dump_on_crash;
+	for ( i = 0 ; i < NUM_CRASH_SIGNALS ; i++ )
+		sigaction(CRASH_SIGNALS[i], &sa, NULL);
+
+	TRACING = 1;
+	return 0;
+}
+
+/* stop tracing and dump the rings; they are kept by their threads */
+void trace_close() {
+	int i;
+
+	if ( trace_file[0] == '\0' )
+		return;
+	TRACING = 0;
+	trace_dump();
+	signal(SIGUSR1, SIG_DFL);
+	signal(SIGUSR2, SIG_DFL);
+	for ( i = 0 ; i < NUM_CRASH_SIGNALS ; i++ )
+		signal(CRASH_SIGNALS[i], SIG_DFL);
+	trace_file[0] = '\0';
+}
+
+#endif
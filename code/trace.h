@@ -0,0 +1,102 @@
+#ifndef _TRACE_H
+#define _TRACE_H
+
+#include <stdint.h>
+
+/*
+ * event tracing: what the simulator and the GA decide, as binary
+ * records in one ring buffer per thread. Recording an event is a few
+ * stores, and a single test of a flag while tracing is off; the rings
+ * hold the last TRACE_EVENTS events of every thread.
+ *
+ * Tracing is switched on by trace_open(), and on and off at run time
+ * with SIGUSR2. The rings are dumped into the trace file on SIGUSR1, on
+ * a crash (SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT) and by
+ * trace_close(); events recorded during a dump may be torn. tracedump
+ * decodes the file.
+ *
+ * The file is a trace_header_t, then for every thread a trace_ring_header_t
+ * followed by its events, oldest first.
+ */
+#define TRACE_MAGIC "SIMTRACE"
+#define TRACE_VERSION 1
+#define TRACE_EVENTS 65536	/* per thread, a power of 2 */
+#define TRACE_MAX_THREADS 256
+
+enum trace_type_e {
+	TR_ACTION_START = 1,	/* a: action, b: condition */
+	TR_ACTION_END,		/* a: action, b: what execute_action() returns */
+	TR_CONDITION,		/* a: condition, b: 1 if verified */
+	TR_END_OF_RAIL,
+	TR_END_OF_PLATFORM,
+	TR_OUT_OF_BUDGET,	/* a: outcome_e */
+	TR_OPERATOR,		/* a: operator_e, b: locus, or hidden neurons/activation */
+	TR_OFFSPRING,		/* b: length of the new strategy */
+	NUM_TRACE_TYPES
+};
+
+/* x and y are the sensor position and angle, for the simulator's events */
+struct trace_event_t {
+	uint64_t stamp;		/* TSC, or the event's number where there is none */
+	uint16_t type;
+	uint16_t a;
+	int32_t b;
+	float x, y;
+};
+
+struct trace_header_t {
+	char magic[8];
+	uint32_t version;
+	uint32_t event_size;
+	uint32_t tsc;		/* stamps are time stamp counter ticks */
+	uint32_t rings;
+};
+
+struct trace_ring_header_t {
+	uint32_t thread;	/* in the order threads first recorded */
+	uint32_t count;		/* events that follow */
+	uint64_t recorded;	/* since the start, including those overwritten */
+};
+
+struct trace_ring_t {
+	uint64_t head;
+	uint32_t thread;
+	struct trace_event_t events[TRACE_EVENTS];
+};
+
+extern volatile int TRACING;
+extern __thread struct trace_ring_t *TRACE_RING;
+
+struct trace_ring_t *trace_ring();
+int trace_open(char *filename);
+int trace_dump();
+void trace_close();
+
+static inline uint64_t trace_stamp(struct trace_ring_t *r) {
+#if defined(__x86_64__) || defined(__i386__)
+	return __builtin_ia32_rdtsc();
+#else
+	return r->head;
+#endif
+}
+
+static inline void trace(int type, int a, int b, float x, float y) {
+	struct trace_ring_t *r;
+	struct trace_event_t *e;
+
+	if ( __builtin_expect(TRACING == 0, 1) )
+		return;
+	r = TRACE_RING != NULL ? TRACE_RING : trace_ring();
+	if ( r == NULL )
+		return;
+	e = &r->events[r->head & (TRACE_EVENTS - 1)];
+	e->stamp = trace_stamp(r);
+	e->type = type;
+	e->a = a;
+	e->b = b;
+	e->x = x;
+	e->y = y;
+	r->head++;
+}
+
+#endif
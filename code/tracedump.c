@@ -0,0 +1,109 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "trace.h"
+
+/*
+ * decoder of the trace files (see trace.h): one line per event, thread
+ * after thread, oldest first:
+ *   <thread> <stamp> <event> <arguments> [<sensor position> <angle>]
+ * Stamps are relative to the first event of the file.
+ */
+
+/* as action_e, condition_e, outcome_e and operator_e */
+static const char *ACTIONS[] = { "?", "move-left", "move-right", "rotate-left", 
+	"rotate-right", "skip-left", "skip-right" };
+static const char *CONDITIONS[] = { "?", "non-object", "object" };
+static const char *BUDGETS[] = { "?", "action-budget", "strategy-budget" };
+static const char *OPERATORS[] = { "add", "remove", "change", "insert", "copy", 
+	"resize", "activation", "adopt" };
+
+#define NAME(names, i) ((i) < sizeof(names) / sizeof(names[0]) ? names[i] : "?")
+
+static void print_event(struct trace_ring_header_t *rh, struct trace_event_t *e, 
+		uint64_t origin) {
+	printf("%u %lld ", rh->thread, (long long)(e->stamp - origin));
+	switch ( e->type ) {
+		case TR_ACTION_START:
+			printf("action-start %s %s", NAME(ACTIONS, e->a), NAME(CONDITIONS, e->b));
+			break;
+		case TR_ACTION_END:
+			printf("action-end %s %d", NAME(ACTIONS, e->a), e->b);
+			break;
+		case TR_CONDITION:
+			printf("condition %s %s", NAME(CONDITIONS, e->a), 
+					e->b ? "verified" : "not-verified");
+			break;
+		case TR_END_OF_RAIL:
+			printf("end-of-rail");
+			break;
+		case TR_END_OF_PLATFORM:
+			printf("end-of-platform");
+			break;
+		case TR_OUT_OF_BUDGET:
+			printf("out-of-%s %d", NAME(BUDGETS, e->a), e->b);
+			break;
+		case TR_OPERATOR:
+			printf("operator %s %d\n", NAME(OPERATORS, e->a), e->b);
+			return;
+		case TR_OFFSPRING:
+			printf("offspring %d\n", e->b);
+			return;
+		default:
+			printf("unknown-%u %u %d", e->type, e->a, e->b);
+			break;
+	}
+	printf(" %f %f\n", e->x, e->y);
+}
+
+int main(int argc, char **argv) {
+	struct trace_header_t h;
+	struct trace_ring_header_t rh;
+	struct trace_event_t e;
+	uint64_t origin = 0;
+	int first = 1;
+	unsigned int i, j;
+	FILE *in;
+
+	if ( argc != 2 ) {
+		fprintf(stderr, "Usage: %s <trace file>\n", argv[0]);
+		return -1;
+	}
+	in = fopen(argv[1], "rb");
+	if ( in == NULL ) {
+		perror("Unable to open the trace");
+		return -1;
+	}
+	if ( fread(&h, sizeof(h), 1, in) != 1 || memcmp(h.magic, TRACE_MAGIC, 8) != 0 
+			|| h.version != TRACE_VERSION || h.event_size != sizeof(e) ) {
+		fprintf(stderr, "%s: not a trace of this version\n", argv[1]);
+		fclose(in);
+		return -1;
+	}
+
+	printf("# %u threads, stamps in %s\n", h.rings, h.tsc ? "TSC ticks" : "events");
+	for ( i = 0 ; i < h.rings ; i++ ) {
+		if ( fread(&rh, sizeof(rh), 1, in) != 1 )
+			goto truncated;
+		printf("# thread %u: last %u of %llu events\n", rh.thread, rh.count, 
+				(unsigned long long)rh.recorded);
+		for ( j = 0 ; j < rh.count ; j++ ) {
+			if ( fread(&e, sizeof(e), 1, in) != 1 )
+				goto truncated;
+			if ( first ) {
+				origin = e.stamp;
+				first = 0;
+			}
+			print_event(&rh, &e, origin);
+		}
+	}
+
+	fclose(in);
+	return 0;
+
+truncated:
+	fprintf(stderr, "%s: truncated\n", argv[1]);
+	fclose(in);
+	return -1;
+}